@@ -35,6 +35,8 @@ static ngx_int_t ngx_getopt(ngx_master_ctx_t *ctx, ngx_cycle_t *cycle);
 static void *ngx_core_module_create_conf(ngx_cycle_t *cycle);
 static char *ngx_core_module_init_conf(ngx_cycle_t *cycle, void *conf);
 static char *ngx_set_user(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
+static char *ngx_set_pool_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+                                void *conf);
 
 
 static ngx_command_t  ngx_core_commands[] = {
@@ -60,6 +62,13 @@ static ngx_command_t  ngx_core_commands[] = {
       offsetof(ngx_core_conf_t, worker_processes),
       NULL },
 
+    { ngx_string("pool_cache"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
+      ngx_set_pool_cache,
+      0,
+      0,
+      NULL },
+
 #if (NGX_THREADS)
 
     { ngx_string("worker_threads"),
@@ -135,6 +144,12 @@ int main(int argc, char *const *argv)
      */
     ngx_time_init();
 
+    // 选择 CPU 支持的 SIMD 版本的字符串函数
+    ngx_string_init(NGX_STRING_AVX2);
+
+    // 选择缓存键的哈希函数，CPU 支持 SSE4.2 时用 CRC32C 指令
+    ngx_crc_init(NGX_CRC_SSE42);
+
 #if (HAVE_PCRE)
     ngx_regex_init();
 #endif
@@ -459,6 +474,7 @@ static void *ngx_core_module_create_conf(ngx_cycle_t *cycle)
     ccf->daemon = NGX_CONF_UNSET;
     ccf->master = NGX_CONF_UNSET;
     ccf->worker_processes = NGX_CONF_UNSET;
+    ccf->pool_cache = NGX_CONF_UNSET;
 #if (NGX_THREADS)
     ccf->worker_threads = NGX_CONF_UNSET;
     ccf->thread_stack_size = NGX_CONF_UNSET;
@@ -482,6 +498,7 @@ static char *ngx_core_module_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_conf_init_value(ccf->daemon, 1);
     ngx_conf_init_value(ccf->master, 1);
     ngx_conf_init_value(ccf->worker_processes, 1);
+    ngx_conf_init_value(ccf->pool_cache, 0);
 
 #if (NGX_THREADS)
     ngx_conf_init_value(ccf->worker_threads, 0);
@@ -585,3 +602,30 @@ static char *ngx_set_user(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
 #endif
 }
+
+
+/* the count is passed to ngx_pool_cache_init() as ngx_uint_t */
+
+static char *ngx_set_pool_cache(ngx_conf_t *cf, ngx_command_t *cmd,
+                                void *conf)
+{
+    ngx_core_conf_t  *ccf = conf;
+
+    ngx_str_t        *value;
+
+    if (ccf->pool_cache != NGX_CONF_UNSET) {
+        return "is duplicate";
+    }
+
+    value = (ngx_str_t *) cf->args->elts;
+
+    ccf->pool_cache = ngx_atoi(value[1].data, value[1].len);
+
+    if (ccf->pool_cache < 0) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid value \"%s\"", value[1].data);
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
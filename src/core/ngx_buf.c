@@ -8,6 +8,33 @@
 #include <ngx_core.h>
 
 
+#if !(NGX_THREADS)
+
+/*
+ * the chain links are allocated from the heap by chunks and are recycled
+ * within the worker process.  The link is tagged by the pool that owns it
+ * and is kept in the pool list until it is freed by ngx_free_chain()
+ * or until the pool is destroyed.  So the links that are released
+ * by the long responses are reused by the same and by the next requests.
+ */
+
+#define NGX_CHAIN_LINKS_CHUNK  64
+
+typedef struct ngx_chain_link_s  ngx_chain_link_t;
+
+struct ngx_chain_link_s {
+    ngx_chain_t         chain;     /* must be the first */
+    ngx_pool_t         *pool;      /* the owner, NULL for the free link */
+    ngx_chain_link_t   *next;
+    ngx_chain_link_t  **prev;
+};
+
+
+static ngx_chain_link_t  *ngx_free_chain_links;
+
+#endif
+
+
 ngx_buf_t *ngx_create_temp_buf(ngx_pool_t *pool, size_t size)
 {
     ngx_buf_t *b;
@@ -148,7 +175,9 @@ void ngx_chain_update_chains(ngx_chain_t **free, ngx_chain_t **busy,
 #endif
 
         if ((*busy)->buf->tag != tag) {
+            tl = *busy;
             *busy = (*busy)->next;
+            ngx_free_chain(tl);
             continue;
         }
 
@@ -160,3 +189,81 @@ void ngx_chain_update_chains(ngx_chain_t **free, ngx_chain_t **busy,
         *free = tl;
     }
 }
+
+
+#if !(NGX_THREADS)
+
+ngx_chain_t *ngx_alloc_chain_link(ngx_pool_t *pool)
+{
+    ngx_uint_t         i;
+    ngx_chain_link_t  *link;
+
+    if (ngx_free_chain_links == NULL) {
+
+        link = ngx_alloc(NGX_CHAIN_LINKS_CHUNK * sizeof(ngx_chain_link_t),
+                         pool->log);
+        if (link == NULL) {
+            return NULL;
+        }
+
+        for (i = 0; i < NGX_CHAIN_LINKS_CHUNK; i++) {
+            link[i].pool = NULL;
+            link[i].next = ngx_free_chain_links;
+            ngx_free_chain_links = &link[i];
+        }
+    }
+
+    link = ngx_free_chain_links;
+    ngx_free_chain_links = link->next;
+
+    link->pool = pool;
+    link->prev = (ngx_chain_link_t **) &pool->chains;
+    link->next = pool->chains;
+
+    if (link->next) {
+        link->next->prev = &link->next;
+    }
+
+    pool->chains = link;
+
+    return &link->chain;
+}
+
+
+void ngx_free_chain(ngx_chain_t *cl)
+{
+    ngx_chain_link_t  *link;
+
+    link = (ngx_chain_link_t *) cl;
+
+    *link->prev = link->next;
+
+    if (link->next) {
+        link->next->prev = link->prev;
+    }
+
+    link->pool = NULL;
+    link->next = ngx_free_chain_links;
+    ngx_free_chain_links = link;
+}
+
+
+void ngx_release_chain_links(ngx_pool_t *pool)
+{
+    ngx_chain_link_t  *link;
+
+    for (link = pool->chains; /* void */; link = link->next) {
+        link->pool = NULL;
+
+        if (link->next == NULL) {
+            break;
+        }
+    }
+
+    link->next = ngx_free_chain_links;
+    ngx_free_chain_links = pool->chains;
+
+    pool->chains = NULL;
+}
+
+#endif
@@ -121,7 +121,20 @@ ngx_chain_t *ngx_create_chain_of_bufs(ngx_pool_t *pool, ngx_bufs_t *bufs);
 #define ngx_calloc_buf(pool) ngx_pcalloc(pool, sizeof(ngx_buf_t))
 
 
+#if (NGX_THREADS)
+
+/* the worker chain links free list is not shared by the threads */
+
 #define ngx_alloc_chain_link(pool) ngx_palloc(pool, sizeof(ngx_chain_t))
+#define ngx_free_chain(cl)
+
+#else
+
+ngx_chain_t *ngx_alloc_chain_link(ngx_pool_t *pool);
+void ngx_free_chain(ngx_chain_t *cl);
+void ngx_release_chain_links(ngx_pool_t *pool);
+
+#endif
 
 
 #define ngx_alloc_link_and_set_buf(chain, b, pool, error)                    \
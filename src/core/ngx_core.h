@@ -48,10 +48,12 @@ typedef void (*ngx_event_handler_pt)(ngx_event_t *ev);
 #include <ngx_log.h>
 #include <ngx_alloc.h>
 #include <ngx_palloc.h>
+#include <ngx_slab.h>
 #include <ngx_buf.h>
 #include <ngx_array.h>
 #include <ngx_list.h>
 #include <ngx_table.h>
+#include <ngx_hash.h>
 #include <ngx_file.h>
 #include <ngx_files.h>
 #include <ngx_crc.h>
@@ -59,6 +61,7 @@ typedef void (*ngx_event_handler_pt)(ngx_event_t *ev);
 #include <ngx_regex.h>
 #endif
 #include <ngx_rbtree.h>
+#include <ngx_radix_tree.h>
 #include <ngx_times.h>
 #include <ngx_inet.h>
 #include <ngx_cycle.h>
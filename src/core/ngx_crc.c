@@ -0,0 +1,149 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * the CRC32C version is built for the SSE4.2 target by gcc 4.9+
+ * and is used only if the CPU supports SSE4.2
+ */
+
+#if ((__x86_64__ || __i386__) && __GNUC__                                    \
+     && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)))
+
+#include <nmmintrin.h>
+
+#define NGX_HAVE_SSE42  1
+
+#endif
+
+
+#define ngx_crc_rotl64(x, r)  ((x) << (r) | (x) >> (64 - (r)))
+
+
+static uint32_t ngx_crc_fast_portable(u_char *data, size_t len);
+
+#if (NGX_HAVE_SSE42)
+static uint32_t ngx_crc_mix(uint32_t h);
+static uint32_t ngx_crc_fast_sse42(u_char *data, size_t len)
+    __attribute__ ((target ("sse4.2")));
+#endif
+
+
+uint32_t  (*ngx_crc_fast)(u_char *data, size_t len) = ngx_crc_fast_portable;
+
+
+ngx_uint_t ngx_crc_init(ngx_uint_t hw)
+{
+#if (NGX_HAVE_SSE42)
+
+    if (hw >= NGX_CRC_SSE42 && __builtin_cpu_supports("sse4.2")) {
+        ngx_crc_fast = ngx_crc_fast_sse42;
+        return NGX_CRC_SSE42;
+    }
+
+#endif
+
+    ngx_crc_fast = ngx_crc_fast_portable;
+
+    return NGX_CRC_PORTABLE;
+}
+
+
+/* the murmur3 like hash of the 8-byte words */
+
+static uint32_t ngx_crc_fast_portable(u_char *data, size_t len)
+{
+    uint64_t  h, w;
+
+    h = len;
+
+    for (/* void */; len >= 8; len -= 8, data += 8) {
+        ngx_memcpy(&w, data, 8);
+
+        w *= 0x87c37b91114253d5ULL;
+        w = ngx_crc_rotl64(w, 31);
+        w *= 0x4cf5ad432745937fULL;
+
+        h ^= w;
+        h = ngx_crc_rotl64(h, 27) * 5 + 0x52dce729;
+    }
+
+    if (len) {
+        w = 0;
+        ngx_memcpy(&w, data, len);
+
+        w *= 0x87c37b91114253d5ULL;
+        w = ngx_crc_rotl64(w, 31);
+        w *= 0x4cf5ad432745937fULL;
+
+        h ^= w;
+    }
+
+    /* the murmur3 64-bit finalizer */
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return (uint32_t) h;
+}
+
+
+#if (NGX_HAVE_SSE42)
+
+static uint32_t ngx_crc_fast_sse42(u_char *data, size_t len)
+{
+    uint32_t  crc, w;
+#if (__x86_64__)
+    uint64_t  crc64, w64;
+
+    crc64 = 0xffffffff ^ len;
+
+    for (/* void */; len >= 8; len -= 8, data += 8) {
+        ngx_memcpy(&w64, data, 8);
+        crc64 = _mm_crc32_u64(crc64, w64);
+    }
+
+    crc = (uint32_t) crc64;
+#else
+
+    crc = 0xffffffff ^ len;
+#endif
+
+    for (/* void */; len >= 4; len -= 4, data += 4) {
+        ngx_memcpy(&w, data, 4);
+        crc = _mm_crc32_u32(crc, w);
+    }
+
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+
+    /* CRC is linear, so its low bits are mixed for the small tables */
+
+    return ngx_crc_mix(crc);
+}
+
+
+/* the murmur3 32-bit finalizer */
+
+static uint32_t ngx_crc_mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+#endif
@@ -30,4 +30,19 @@ ngx_inline static uint32_t ngx_crc(char *data, size_t len)
 }
 
 
+/*
+ * the fast 32-bit hash of the cache keys and the MIME types,
+ * ngx_crc_init() sets the CRC32C version if the CPU supports SSE4.2,
+ * the hash values of the versions differ so the version must not be changed
+ * after the hash tables have been built
+ */
+
+#define NGX_CRC_PORTABLE  0
+#define NGX_CRC_SSE42     1
+
+extern uint32_t  (*ngx_crc_fast)(u_char *data, size_t len);
+
+ngx_uint_t ngx_crc_init(ngx_uint_t hw);
+
+
 #endif /* _NGX_CRC_H_INCLUDED_ */
@@ -62,6 +62,7 @@ typedef struct {
      ngx_flag_t  master;
 
      ngx_int_t   worker_processes;
+     ngx_int_t   pool_cache;
 
      ngx_uid_t   user;
      ngx_gid_t   group;
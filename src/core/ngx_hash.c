@@ -0,0 +1,174 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+ngx_uint_t ngx_hash_key_lc(u_char *data, size_t len)
+{
+    ngx_uint_t  i, key;
+
+    key = 0;
+
+    for (i = 0; i < len; i++) {
+        key = ngx_hash(key, ngx_tolower(data[i]));
+    }
+
+    return key;
+}
+
+
+/* the lowercase copy and its hash */
+
+ngx_uint_t ngx_hash_strlow(u_char *dst, u_char *src, size_t n)
+{
+    ngx_uint_t  key;
+
+    ngx_strlow(dst, src, n);
+
+    for (key = 0; n--; dst++) {
+        key = ngx_hash(key, *dst);
+    }
+
+    return key;
+}
+
+
+/*
+ * the hash size is searched from the number of the names up to max_size
+ * to find the first size without the collisions, i.e. the perfect hash;
+ * if there is no such size then the size with the shortest buckets is used
+ */
+
+ngx_int_t ngx_hash_init(ngx_hash_t *hash, ngx_pool_t *pool,
+                        ngx_hash_key_t *names, ngx_uint_t nelts,
+                        ngx_uint_t max_size)
+{
+    u_char         **lc;
+    ngx_uint_t       i, n, size, best, chain, best_chain, *keys, *test;
+    ngx_hash_elt_t  *elts, *elt;
+
+    if (max_size < nelts) {
+        max_size = nelts;
+    }
+
+    if (max_size == 0) {
+        max_size = 1;
+    }
+
+    if (!(keys = ngx_alloc((nelts + max_size) * sizeof(ngx_uint_t)
+                           + nelts * sizeof(u_char *), pool->log)))
+    {
+        return NGX_ERROR;
+    }
+
+    test = keys + nelts;
+    lc = (u_char **) (test + max_size);
+
+    for (n = 0; n < nelts; n++) {
+        if (!(lc[n] = ngx_palloc(pool, names[n].key.len))) {
+            ngx_free(keys);
+            return NGX_ERROR;
+        }
+
+        keys[n] = ngx_hash_strlow(lc[n], names[n].key.data, names[n].key.len);
+    }
+
+    best = max_size;
+    best_chain = nelts + 1;
+
+    for (size = nelts ? nelts : 1; size <= max_size; size++) {
+
+        ngx_memzero(test, size * sizeof(ngx_uint_t));
+
+        chain = 0;
+
+        for (n = 0; n < nelts; n++) {
+            i = keys[n] % size;
+
+            if (++test[i] > chain) {
+                chain = test[i];
+
+                if (chain >= best_chain) {
+                    break;
+                }
+            }
+        }
+
+        if (chain < best_chain) {
+            best = size;
+            best_chain = chain;
+
+            if (chain <= 1) {
+                break;
+            }
+        }
+    }
+
+    size = best;
+
+    if (!(hash->buckets = ngx_palloc(pool, size * sizeof(ngx_hash_elt_t *)))) {
+        ngx_free(keys);
+        return NGX_ERROR;
+    }
+
+    /* every bucket has the terminating element */
+
+    if (!(elts = ngx_pcalloc(pool, (nelts + size) * sizeof(ngx_hash_elt_t)))) {
+        ngx_free(keys);
+        return NGX_ERROR;
+    }
+
+    ngx_memzero(test, size * sizeof(ngx_uint_t));
+
+    for (n = 0; n < nelts; n++) {
+        test[keys[n] % size]++;
+    }
+
+    for (i = 0; i < size; i++) {
+        hash->buckets[i] = elts;
+        elts += test[i] + 1;
+        test[i] = 0;
+    }
+
+    for (n = 0; n < nelts; n++) {
+        i = keys[n] % size;
+
+        elt = &hash->buckets[i][test[i]++];
+
+        elt->value = names[n].value;
+        elt->key = keys[n];
+        elt->len = names[n].key.len;
+        elt->name = lc[n];
+    }
+
+    hash->size = size;
+
+    ngx_free(keys);
+
+    return NGX_OK;
+}
+
+
+void *ngx_hash_find(ngx_hash_t *hash, ngx_uint_t key, u_char *name,
+                    size_t len)
+{
+    ngx_hash_elt_t  *elt;
+
+    for (elt = hash->buckets[key % hash->size]; elt->value; elt++) {
+
+        if (elt->key != key || elt->len != len) {
+            continue;
+        }
+
+        if (ngx_memcasecmp(elt->name, name, len) == 0) {
+            return elt->value;
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,52 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ */
+
+
+#ifndef _NGX_HASH_H_INCLUDED_
+#define _NGX_HASH_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+typedef struct {
+    void            *value;
+    ngx_uint_t       key;
+    size_t           len;
+    u_char          *name;          /* in lowercase */
+} ngx_hash_elt_t;
+
+
+/*
+ * the read only hash that is built at the configuration time,
+ * every bucket is the array of the elements terminated by the NULL value
+ */
+
+typedef struct {
+    ngx_hash_elt_t  **buckets;
+    ngx_uint_t        size;
+} ngx_hash_t;
+
+
+typedef struct {
+    ngx_str_t         key;
+    void             *value;
+} ngx_hash_key_t;
+
+
+#define ngx_hash(key, c)  ((ngx_uint_t) (key) * 31 + (c))
+
+
+ngx_uint_t ngx_hash_key_lc(u_char *data, size_t len);
+ngx_uint_t ngx_hash_strlow(u_char *dst, u_char *src, size_t n);
+ngx_int_t ngx_hash_init(ngx_hash_t *hash, ngx_pool_t *pool,
+                        ngx_hash_key_t *names, ngx_uint_t nelts,
+                        ngx_uint_t max_size);
+void *ngx_hash_find(ngx_hash_t *hash, ngx_uint_t key, u_char *name,
+                    size_t len);
+
+
+#endif /* _NGX_HASH_H_INCLUDED_ */
@@ -71,7 +71,9 @@ ngx_int_t ngx_output_chain(ngx_output_chain_ctx_t *ctx, ngx_chain_t *in)
                 ngx_log_error(NGX_LOG_ALERT, ctx->pool->log, 0,
                               "zero size buf");
 
-                ctx->in = ctx->in->next;
+                cl = ctx->in;
+                ctx->in = cl->next;
+                ngx_free_chain(cl);
 
                 continue;
             }
@@ -95,8 +97,10 @@ ngx_int_t ngx_output_chain(ngx_output_chain_ctx_t *ctx, ngx_chain_t *in)
                 /* get the free buf */
 
                 if (ctx->free) {
-                    ctx->buf = ctx->free->buf;
-                    ctx->free = ctx->free->next;
+                    cl = ctx->free;
+                    ctx->buf = cl->buf;
+                    ctx->free = cl->next;
+                    ngx_free_chain(cl);
 
                 } else if (out || ctx->allocated == ctx->bufs.num) {
 
@@ -159,7 +163,9 @@ ngx_int_t ngx_output_chain(ngx_output_chain_ctx_t *ctx, ngx_chain_t *in)
             /* delete the completed buf from the ctx->in chain */
 
             if (ngx_buf_size(ctx->in->buf) == 0) {
-                ctx->in = ctx->in->next;
+                cl = ctx->in;
+                ctx->in = cl->next;
+                ngx_free_chain(cl);
             }
 
             ngx_alloc_link_and_set_buf(cl, ctx->buf, ctx->pool, NGX_ERROR);
@@ -278,7 +284,7 @@ ngx_int_t ngx_chain_writer(void *data, ngx_chain_t *in)
 {
     ngx_chain_writer_ctx_t *ctx = data;
 
-    ngx_chain_t  *cl;
+    ngx_chain_t  *cl, *next;
 
 
     for (/* void */; in; in = in->next) {
@@ -294,15 +300,24 @@ ngx_int_t ngx_chain_writer(void *data, ngx_chain_t *in)
     ngx_log_debug1(NGX_LOG_DEBUG_CORE, ctx->connection->log, 0,
                    "WRITER0: %X", ctx->out);
 
-    ctx->out = ngx_send_chain(ctx->connection, ctx->out, ctx->limit);
+    cl = ngx_send_chain(ctx->connection, ctx->out, ctx->limit);
 
     ngx_log_debug1(NGX_LOG_DEBUG_CORE, ctx->connection->log, 0,
-                   "WRITER1: %X", ctx->out);
+                   "WRITER1: %X", cl);
 
-    if (ctx->out == NGX_CHAIN_ERROR) {
+    if (cl == NGX_CHAIN_ERROR) {
+        ctx->out = NGX_CHAIN_ERROR;
         return NGX_ERROR;
     }
 
+    /* free the links of the sent bufs */
+
+    while (ctx->out != cl) {
+        next = ctx->out->next;
+        ngx_free_chain(ctx->out);
+        ctx->out = next;
+    }
+
     if (ctx->out == NULL) {
         ctx->last = &ctx->out;
         return NGX_OK;
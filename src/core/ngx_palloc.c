@@ -7,30 +7,81 @@
 #include <ngx_config.h>
 #include <ngx_core.h>
 
+
+#if (NGX_POOL_STAT)
+
+#undef ngx_palloc
+#undef ngx_pcalloc
+
+static void ngx_pool_stat_add(ngx_pool_t *pool, size_t size, char *file);
+
+ngx_pool_stat_t  ngx_pool_stat[NGX_POOL_STAT_SLOTS];
+
+#endif
+
+
+static void *ngx_palloc_block(ngx_pool_t *pool, size_t size);
+static void *ngx_get_cached_block(size_t size);
+static ngx_int_t ngx_put_cached_block(void *p, size_t size);
+
+
+/*
+ * the worker process keeps the freed pool blocks in the per size lists
+ * to reuse them for the next connections and requests,
+ * the pools are created with a few sizes only so the lookup is linear
+ */
+
+#define NGX_POOL_CACHE_SLOTS  8
+
+static ngx_cached_block_slot_t  ngx_pool_cache[NGX_POOL_CACHE_SLOTS];
+static ngx_uint_t               ngx_pool_cache_max;
+
+
 // nginx_create_pool 新建一个内存池
 // size 就是这个池的总大小
 ngx_pool_t *ngx_create_pool(size_t size, ngx_log_t *log)
 {
     ngx_pool_t  *p;
 
-    if (!(p = ngx_alloc(size, log))) {
+    if (!(p = ngx_get_cached_block(size)) && !(p = ngx_alloc(size, log))) {
        return NULL;
     }
 
     p->last = (char *) p + sizeof(ngx_pool_t);
     p->end = (char *) p + size;
+    p->current = p;
     p->next = NULL;
+    p->failed = 0;
     p->large = NULL;
+    p->chains = NULL;
+    p->cleanup = NULL;
     p->log = log;
 
+#if (NGX_POOL_STAT)
+    p->stat_phase = 0;
+#endif
+
     return p;
 }
 
 // ngx_destroy_pool 释放整个池
 void ngx_destroy_pool(ngx_pool_t *pool)
 {
-    ngx_pool_t        *p, *n;
-    ngx_pool_large_t  *l;
+    ngx_pool_t          *p, *n;
+    ngx_pool_large_t    *l;
+    ngx_pool_cleanup_t  *c;
+
+    for (c = pool->cleanup; c; c = c->next) {
+        c->handler(c->data);
+    }
+
+#if !(NGX_THREADS)
+
+    if (pool->chains) {
+        ngx_release_chain_links(pool);
+    }
+
+#endif
 
     for (l = pool->large; l; l = l->next) {
 
@@ -62,7 +113,9 @@ void ngx_destroy_pool(ngx_pool_t *pool)
 #endif
 
     for (p = pool, n = pool->next; /* void */; p = n, n = n->next) {
-        free(p);
+        if (ngx_put_cached_block(p, p->end - (char *) p) == NGX_DECLINED) {
+            free(p);
+        }
 
         if (n == NULL) {
             break;
@@ -71,19 +124,46 @@ void ngx_destroy_pool(ngx_pool_t *pool)
 }
 
 
+// ngx_pool_cleanup_add 添加池销毁前要调用的清理函数
+ngx_int_t ngx_pool_cleanup_add(ngx_pool_t *pool, ngx_pool_cleanup_pt handler,
+                               void *data)
+{
+    ngx_pool_cleanup_t  *c;
+
+    if (!(c = ngx_palloc(pool, sizeof(ngx_pool_cleanup_t)))) {
+        return NGX_ERROR;
+    }
+
+    c->handler = handler;
+    c->data = data;
+    c->next = pool->cleanup;
+
+    pool->cleanup = c;
+
+    return NGX_OK;
+}
+
+
+// ngx_pool_cache_init 开启 worker 进程的内存块缓存，max 是每种大小最多缓存的块数
+void ngx_pool_cache_init(ngx_uint_t max)
+{
+    ngx_pool_cache_max = max;
+}
+
+
 // ngx_palloc 创建一个节点
 // 内存在堆上
 void *ngx_palloc(ngx_pool_t *pool, size_t size)
 {
     char              *begin_position;
-    ngx_pool_t        *cur_node, *next_node;
+    ngx_pool_t        *cur_node;
 
     // 如果是小块
     if (size <= (size_t) NGX_MAX_ALLOC_FROM_POOL
         && size <= (size_t) (pool->end - (char *) pool) - sizeof(ngx_pool_t))
     {
-        // 看 pool->next，也就是链表中的当前元素
-        for (cur_node = pool, next_node = pool->next; /* void */; cur_node = next_node, next_node = next_node->next) {
+        // 从 pool->current 开始查找，之前的节点都已经满了
+        for (cur_node = pool->current; cur_node; cur_node = cur_node->next) {
             // 定位到第一个对齐的位置
             begin_position = ngx_align(cur_node->last);
 
@@ -93,24 +173,10 @@ void *ngx_palloc(ngx_pool_t *pool, size_t size)
 
                 return begin_position;
             }
-
-            if (next_node == NULL) {
-                break;
-            }
         }
 
-        /* allocate a new pool block */
-
         // 没找到，只能分配出一个节点
-        if (!(next_node = ngx_create_pool((size_t) (cur_node->end - (char *) cur_node), cur_node->log))) {
-            return NULL;
-        }
-
-        cur_node->next = next_node;
-        begin_position = next_node->last;
-        next_node->last += size;
-
-        return begin_position;
+        return ngx_palloc_block(pool, size);
     }
 
     /* allocate a large block */
@@ -167,6 +233,43 @@ void *ngx_palloc(ngx_pool_t *pool, size_t size)
 }
 
 
+static void *ngx_palloc_block(ngx_pool_t *pool, size_t size)
+{
+    char        *m;
+    ngx_pool_t  *p, *new, *current;
+
+    /* allocate a new pool block */
+
+    if (!(new = ngx_create_pool((size_t) (pool->end - (char *) pool),
+                                pool->log)))
+    {
+        return NULL;
+    }
+
+    m = new->last;
+    new->last += size;
+
+    /*
+     * every block that has failed this allocation gets a mark,
+     * the blocks that have failed too often are never tried again
+     */
+
+    current = pool->current;
+
+    for (p = current; p->next; p = p->next) {
+        if (++p->failed >= NGX_POOL_FAILED) {
+            current = p->next;
+        }
+    }
+
+    p->next = new;
+
+    pool->current = current ? current : new;
+
+    return m;
+}
+
+
 // ngx_pfree 释放指定节点
 ngx_int_t ngx_pfree(ngx_pool_t *pool, void *p)
 {
@@ -200,29 +303,142 @@ void *ngx_pcalloc(ngx_pool_t *pool, size_t size)
     return p;
 }
 
-#if 0
+#if (NGX_POOL_STAT)
+
+void *ngx_palloc_stat(ngx_pool_t *pool, size_t size, char *file)
+{
+    void  *p;
+
+    if ((p = ngx_palloc(pool, size))) {
+        ngx_pool_stat_add(pool, size, file);
+    }
+
+    return p;
+}
+
+
+void *ngx_pcalloc_stat(ngx_pool_t *pool, size_t size, char *file)
+{
+    void  *p;
+
+    if ((p = ngx_pcalloc(pool, size))) {
+        ngx_pool_stat_add(pool, size, file);
+    }
+
+    return p;
+}
+
+
+static void ngx_pool_stat_add(ngx_pool_t *pool, size_t size, char *file)
+{
+    ngx_uint_t        i, n;
+    ngx_pool_stat_t  *stat;
+
+    /* the __FILE__ literals are the same within a source file */
+
+    i = (((uintptr_t) file >> 3) * 31 + pool->stat_phase)
+                                                   % NGX_POOL_STAT_SLOTS;
+
+    for (n = 0; n < NGX_POOL_STAT_SLOTS; n++) {
+        stat = &ngx_pool_stat[i];
+
+        if (stat->file == NULL) {
+            stat->file = file;
+            stat->phase = pool->stat_phase;
+            break;
+        }
+
+        if (stat->file == file && stat->phase == pool->stat_phase) {
+            break;
+        }
+
+        i = (i + 1) % NGX_POOL_STAT_SLOTS;
+    }
+
+    if (n == NGX_POOL_STAT_SLOTS) {
+        return;
+    }
+
+    stat->allocs++;
+
+    if (size <= (size_t) NGX_MAX_ALLOC_FROM_POOL
+        && size <= (size_t) (pool->end - (char *) pool) - sizeof(ngx_pool_t))
+    {
+        stat->small += size;
+
+    } else {
+        stat->large += size;
+    }
+}
+
+#endif
+
 
 static void *ngx_get_cached_block(size_t size)
 {
-    void                     *p;
+    ngx_uint_t                i;
+    ngx_cached_block_t       *block;
     ngx_cached_block_slot_t  *slot;
 
-    if (ngx_cycle->cache == NULL) {
+    if (ngx_pool_cache_max == 0) {
         return NULL;
     }
 
-    slot = &ngx_cycle->cache[(size + ngx_pagesize - 1) / ngx_pagesize];
+    for (i = 0; i < NGX_POOL_CACHE_SLOTS; i++) {
+        slot = &ngx_pool_cache[i];
 
-    slot->tries++;
+        if (slot->size != size) {
+            continue;
+        }
+
+        slot->tries++;
+
+        if (slot->number == 0) {
+            return NULL;
+        }
 
-    if (slot->number) {
-        p = slot->block;
-        slot->block = slot->block->next;
+        block = slot->block;
+        slot->block = block->next;
         slot->number--;
-        return p;
+
+        return block;
     }
 
     return NULL;
 }
 
-#endif
+
+static ngx_int_t ngx_put_cached_block(void *p, size_t size)
+{
+    ngx_uint_t                i;
+    ngx_cached_block_t       *block;
+    ngx_cached_block_slot_t  *slot;
+
+    if (ngx_pool_cache_max == 0) {
+        return NGX_DECLINED;
+    }
+
+    for (i = 0; i < NGX_POOL_CACHE_SLOTS; i++) {
+        slot = &ngx_pool_cache[i];
+
+        if (slot->size == size) {
+            break;
+        }
+
+        if (slot->size == 0) {
+            slot->size = size;
+            break;
+        }
+    }
+
+    if (i == NGX_POOL_CACHE_SLOTS || slot->number >= ngx_pool_cache_max) {
+        return NGX_DECLINED;
+    }
+
+    block = p;
+    block->next = slot->block;
+    slot->block = block;
+    slot->number++;
+
+    return NGX_OK;
+}
@@ -27,9 +27,27 @@
 
 #define NGX_DEFAULT_POOL_SIZE   (16 * 1024)
 
+/*
+ * a block that could not satisfy NGX_POOL_FAILED small allocations
+ * is considered to be full and is skipped by the following allocations
+ */
+#define NGX_POOL_FAILED          4
+
 #define ngx_test_null(p, alloc, rc)  if ((p = alloc) == NULL) { return rc; }
 
 
+typedef void (*ngx_pool_cleanup_pt)(void *data);
+
+typedef struct ngx_pool_cleanup_s  ngx_pool_cleanup_t;
+
+// ngx_pool_cleanup_s 是池销毁前要调用的清理函数 链表 / 节点
+struct ngx_pool_cleanup_s {
+    ngx_pool_cleanup_pt   handler;
+    void                 *data;
+    ngx_pool_cleanup_t   *next;
+};
+
+
 typedef struct ngx_pool_large_s  ngx_pool_large_t;
 
 // ngx_pool_large_s 是大块内存 链表 / 节点
@@ -70,18 +88,53 @@ struct ngx_pool_s {
     char              *last;
     // 小数据 结束的地址
     char              *end;
+    // current 只在第一个节点中有效，是小块分配开始查找的节点，其之前的节点都已经满了
+    ngx_pool_t        *current;
     // next 为存储普通大小的数据的链表 的下一个节点 。这个一定存在
     ngx_pool_t        *next;
+    // failed 是当前节点分配失败的次数，超过 NGX_POOL_FAILED 次后 current 会跳过它
+    ngx_uint_t         failed;
 
     // large 为存储大数据的链表 的下一个节点。这个可能不存在
     ngx_pool_large_t  *large;
     // 大块还是小块 由 NGX_MAX_ALLOC_FROM_POOL 来定，不同的操作系统不一样。当申请的内存大于这个值时，会按大块内存进行分配
 
+    // chains 为这个池拥有的链表节点，只在第一个节点中有效，池销毁时节点被回收到进程的空闲链表
+    void              *chains;
+
+    // cleanup 为池销毁前要调用的清理函数，只在第一个节点中有效
+    ngx_pool_cleanup_t *cleanup;
+
     // lag 为日志对象
     ngx_log_t         *log;
+
+#if (NGX_POOL_STAT)
+    // stat_phase 是使用者当前所处的阶段，用于内存统计，0 表示不在任何阶段
+    ngx_uint_t         stat_phase;
+#endif
+};
+
+
+typedef struct ngx_cached_block_s  ngx_cached_block_t;
+
+// ngx_cached_block_s 是被释放后缓存起来的内存块
+struct ngx_cached_block_s {
+    ngx_cached_block_t  *next;
 };
 
 
+// ngx_cached_block_slot_t 是同样大小的缓存内存块的链表
+typedef struct {
+    // 块的大小，0 表示空闲的 slot
+    size_t               size;
+    ngx_cached_block_t  *block;
+    // 链表中块的个数，不超过 pool_cache 指令的值
+    ngx_uint_t           number;
+    // 申请这个大小的块的次数
+    ngx_uint_t           tries;
+} ngx_cached_block_slot_t;
+
+
 /*
  * ngx_alloc 申请内存
  */
@@ -98,6 +151,17 @@ void *ngx_calloc(size_t size, ngx_log_t *log);
 ngx_pool_t *ngx_create_pool(size_t size, ngx_log_t *log);
 void ngx_destroy_pool(ngx_pool_t *pool);
 
+/*
+ * ngx_pool_cleanup_add 添加池销毁前要调用的清理函数，后添加的先调用
+ */
+ngx_int_t ngx_pool_cleanup_add(ngx_pool_t *pool, ngx_pool_cleanup_pt handler,
+                               void *data);
+
+/*
+ * ngx_pool_cache_init 开启内存块缓存，被销毁的池的块不再 free()，而是留给新的池
+ */
+void ngx_pool_cache_init(ngx_uint_t max);
+
 /*
  * ngx_palloc 创建一个 size大小的内存块，返回开头的地址
  */
@@ -113,4 +177,40 @@ void *ngx_pcalloc(ngx_pool_t *pool, size_t size);
 ngx_int_t ngx_pfree(ngx_pool_t *pool, void *p);
 
 
+#if (NGX_POOL_STAT)
+
+/*
+ * the pool allocations are accounted by the source file of the caller,
+ * i.e. by the module, and by the phase the pool owner is in;
+ * the counters are per process
+ */
+
+#define NGX_POOL_STAT_SLOTS  1024
+
+typedef struct {
+    char        *file;
+    ngx_uint_t   phase;
+    ngx_uint_t   allocs;
+    ngx_uint_t   small;
+    ngx_uint_t   large;
+} ngx_pool_stat_t;
+
+
+void *ngx_palloc_stat(ngx_pool_t *pool, size_t size, char *file);
+void *ngx_pcalloc_stat(ngx_pool_t *pool, size_t size, char *file);
+
+#define ngx_palloc(pool, size)       ngx_palloc_stat(pool, size, __FILE__)
+#define ngx_pcalloc(pool, size)      ngx_pcalloc_stat(pool, size, __FILE__)
+
+#define ngx_pool_stat_phase(pool, phase)  (pool)->stat_phase = phase
+
+extern ngx_pool_stat_t  ngx_pool_stat[NGX_POOL_STAT_SLOTS];
+
+#else
+
+#define ngx_pool_stat_phase(pool, phase)
+
+#endif
+
+
 #endif /* _NGX_PALLOC_H_INCLUDED_ */
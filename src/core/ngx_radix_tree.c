@@ -8,6 +8,20 @@
 #include <ngx_core.h>
 
 
+typedef struct {
+    uint32_t    *table;
+    uintptr_t   *values;
+    ngx_uint_t   ntables;
+    ngx_uint_t   nvalues;
+} ngx_radix_compile_t;
+
+
+static void ngx_radix_count(ngx_radix_node_t *node, ngx_uint_t depth,
+                            ngx_uint_t *ntables, ngx_uint_t *nvalues);
+static void ngx_radix_compile_node(ngx_radix_compile_t *ctx,
+                                   ngx_radix_node_t *node, ngx_uint_t depth,
+                                   ngx_uint_t index, uint32_t value,
+                                   ngx_uint_t offset);
 static void *ngx_radix_alloc(ngx_radix_tree_t *tree, size_t size);
 
 
@@ -23,6 +37,8 @@ ngx_radix_tree_t *ngx_radix_tree_create(ngx_pool_t *pool)
     tree->free = NULL;
     tree->start = NULL;
     tree->size = 0;
+    tree->table = NULL;
+    tree->values = NULL;
 
     if (!(tree->root = ngx_radix_alloc(tree, sizeof(ngx_radix_node_t)))) {
         return NULL;
@@ -43,10 +59,14 @@ ngx_int_t ngx_radix32tree_insert(ngx_radix_tree_t *tree,
     uint32_t           bit;
     ngx_radix_node_t  *node, *next;
 
-    // 最多支持8层
+    tree->table = NULL;
+
+    // 最多支持32层，mask 的位数就是节点的深度
     bit = 0x80000000;
     node = tree->root;
-    next = NULL;
+
+    // mask 为 0 时就是根节点，和其它重复的前缀一样检查值
+    next = node;
 
     while (bit & mask) {
         if (key & bit) {
@@ -56,12 +76,11 @@ ngx_int_t ngx_radix32tree_insert(ngx_radix_tree_t *tree,
             next = node->left;
         }
 
-        bit >>= 1;
-
         if (next == NULL) {
             break;
         }
 
+        bit >>= 1;
         node = next;
     }
 
@@ -74,12 +93,14 @@ ngx_int_t ngx_radix32tree_insert(ngx_radix_tree_t *tree,
         return NGX_OK;
     }
 
+    /* the intermediate nodes have no value */
+
     while (bit & mask) {
         if (!(next = ngx_radix_alloc(tree, sizeof(ngx_radix_node_t)))) {
             return NGX_ERROR;
         }
 
-        next->value = value;
+        next->value = (uintptr_t) 0;
         next->right = NULL;
         next->left = NULL;
         next->parent = node;
@@ -95,6 +116,8 @@ ngx_int_t ngx_radix32tree_insert(ngx_radix_tree_t *tree,
         node = next;
     }
 
+    node->value = value;
+
     return NGX_OK;
 }
 
@@ -105,6 +128,8 @@ ngx_int_t ngx_radix32tree_delete(ngx_radix_tree_t *tree,
     uint32_t           bit;
     ngx_radix_node_t  *node;
 
+    tree->table = NULL;
+
     bit = 0x80000000;
     node = tree->root;
 
@@ -151,10 +176,22 @@ ngx_int_t ngx_radix32tree_delete(ngx_radix_tree_t *tree,
 
 uintptr_t ngx_radix32tree_find(ngx_radix_tree_t *tree, uint32_t key)
 {
-    uint32_t           bit;
+    uint32_t           bit, n, *table;
     uintptr_t          value;
     ngx_radix_node_t  *node;
 
+    if (tree->table) {
+        table = tree->table;
+        bit = 32 - NGX_RADIX_STRIDE;
+
+        for (n = table[key >> bit]; n & NGX_RADIX_TABLE; /* void */) {
+            bit -= NGX_RADIX_STRIDE;
+            n = table[(n & ~NGX_RADIX_TABLE) + ((key >> bit) & 0xff)];
+        }
+
+        return tree->values[n];
+    }
+
     bit = 0x80000000;
     value = (uintptr_t) 0;
     node = tree->root;
@@ -178,6 +215,323 @@ uintptr_t ngx_radix32tree_find(ngx_radix_tree_t *tree, uint32_t key)
 }
 
 
+ngx_int_t ngx_radix128tree_insert(ngx_radix_tree_t *tree,
+                                  u_char *key, u_char *mask, uintptr_t value)
+{
+    u_char             bit;
+    ngx_uint_t         i;
+    ngx_radix_node_t  *node, *next;
+
+    tree->table = NULL;
+
+    i = 0;
+    bit = 0x80;
+    node = tree->root;
+    next = NULL;
+
+    while (bit & mask[i]) {
+        if (key[i] & bit) {
+            next = node->right;
+
+        } else {
+            next = node->left;
+        }
+
+        if (next == NULL) {
+            break;
+        }
+
+        bit >>= 1;
+        node = next;
+
+        if (bit == 0) {
+            if (++i == 16) {
+                break;
+            }
+
+            bit = 0x80;
+        }
+    }
+
+    if (next) {
+        if (node->value) {
+            return NGX_BUSY;
+        }
+
+        node->value = value;
+        return NGX_OK;
+    }
+
+    while (bit & mask[i]) {
+        if (!(next = ngx_radix_alloc(tree, sizeof(ngx_radix_node_t)))) {
+            return NGX_ERROR;
+        }
+
+        next->value = (uintptr_t) 0;
+        next->right = NULL;
+        next->left = NULL;
+        next->parent = node;
+
+        if (key[i] & bit) {
+            node->right = next;
+
+        } else {
+            node->left = next;
+        }
+
+        bit >>= 1;
+        node = next;
+
+        if (bit == 0) {
+            if (++i == 16) {
+                break;
+            }
+
+            bit = 0x80;
+        }
+    }
+
+    node->value = value;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t ngx_radix128tree_delete(ngx_radix_tree_t *tree,
+                                  u_char *key, u_char *mask)
+{
+    u_char             bit;
+    ngx_uint_t         i;
+    ngx_radix_node_t  *node;
+
+    tree->table = NULL;
+
+    i = 0;
+    bit = 0x80;
+    node = tree->root;
+
+    while (node && i < 16 && (bit & mask[i])) {
+        if (key[i] & bit) {
+            node = node->right;
+
+        } else {
+            node = node->left;
+        }
+
+        bit >>= 1;
+
+        if (bit == 0) {
+            i++;
+            bit = 0x80;
+        }
+    }
+
+    if (node == NULL || node->parent == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (node->right || node->left) {
+        node->value = (uintptr_t) 0;
+        return NGX_OK;
+    }
+
+    for ( ;; ) {
+        if (node->parent->right == node) {
+            node->parent->right = NULL;
+        } else {
+            node->parent->left = NULL;
+        }
+
+        node->right = tree->free;
+        tree->free = node;
+
+        node = node->parent;
+
+        if (node->right || node->left || node->value || node->parent == NULL) {
+            break;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+uintptr_t ngx_radix128tree_find(ngx_radix_tree_t *tree, u_char *key)
+{
+    u_char             bit;
+    uint32_t           n, *table;
+    uintptr_t          value;
+    ngx_uint_t         i;
+    ngx_radix_node_t  *node;
+
+    if (tree->table) {
+        table = tree->table;
+        i = 0;
+
+        for (n = table[key[i++]]; n & NGX_RADIX_TABLE; /* void */) {
+            n = table[(n & ~NGX_RADIX_TABLE) + key[i++]];
+        }
+
+        return tree->values[n];
+    }
+
+    i = 0;
+    bit = 0x80;
+    value = (uintptr_t) 0;
+    node = tree->root;
+
+    while (node) {
+        if (node->value) {
+            value = node->value;
+        }
+
+        if (i == 16) {
+            break;
+        }
+
+        if (key[i] & bit) {
+            node = node->right;
+
+        } else {
+            node = node->left;
+        }
+
+        bit >>= 1;
+
+        if (bit == 0) {
+            i++;
+            bit = 0x80;
+        }
+    }
+
+    return value;
+}
+
+
+/*
+ * the binary tree is expanded into the tables of 2^NGX_RADIX_STRIDE
+ * entries, the value of a prefix is copied into all entries it covers
+ * unless they are covered by a longer prefix, so the lookup takes
+ * one table entry per key byte and stops at the first value entry
+ */
+
+ngx_int_t ngx_radix_tree_compile(ngx_radix_tree_t *tree)
+{
+    ngx_uint_t           ntables, nvalues;
+    ngx_radix_compile_t  ctx;
+
+    ntables = 1;
+    nvalues = 1;
+
+    ngx_radix_count(tree->root, 0, &ntables, &nvalues);
+
+    if (ntables > (NGX_RADIX_TABLE >> NGX_RADIX_STRIDE)
+        || nvalues >= NGX_RADIX_TABLE)
+    {
+        return NGX_ERROR;
+    }
+
+    ctx.table = ngx_palloc(tree->pool, (ntables << NGX_RADIX_STRIDE)
+                                       * sizeof(uint32_t));
+    if (ctx.table == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (!(ctx.values = ngx_palloc(tree->pool, nvalues * sizeof(uintptr_t)))) {
+        return NGX_ERROR;
+    }
+
+    ctx.values[0] = (uintptr_t) 0;
+    ctx.ntables = 1;
+    ctx.nvalues = 1;
+
+    ngx_radix_compile_node(&ctx, tree->root, 0, 0, 0, 0);
+
+    tree->table = ctx.table;
+    tree->values = ctx.values;
+
+    return NGX_OK;
+}
+
+
+static void ngx_radix_count(ngx_radix_node_t *node, ngx_uint_t depth,
+                            ngx_uint_t *ntables, ngx_uint_t *nvalues)
+{
+    if (node->value) {
+        (*nvalues)++;
+    }
+
+    if (node->left == NULL && node->right == NULL) {
+        return;
+    }
+
+    if (depth && depth % NGX_RADIX_STRIDE == 0) {
+        (*ntables)++;
+    }
+
+    if (node->left) {
+        ngx_radix_count(node->left, depth + 1, ntables, nvalues);
+    }
+
+    if (node->right) {
+        ngx_radix_count(node->right, depth + 1, ntables, nvalues);
+    }
+}
+
+
+/*
+ * the node is at the depth bit of the table that starts at the offset,
+ * the absent node leaves the value of its parent prefix in all entries
+ * that it would cover
+ */
+
+static void ngx_radix_compile_node(ngx_radix_compile_t *ctx,
+                                   ngx_radix_node_t *node, ngx_uint_t depth,
+                                   ngx_uint_t index, uint32_t value,
+                                   ngx_uint_t offset)
+{
+    ngx_uint_t  i, n;
+
+    if (node == NULL) {
+        n = 1 << (NGX_RADIX_STRIDE - depth);
+
+        for (i = index * n; i < (index + 1) * n; i++) {
+            ctx->table[offset + i] = value;
+        }
+
+        return;
+    }
+
+    if (node->value) {
+        ctx->values[ctx->nvalues] = node->value;
+        value = ctx->nvalues++;
+    }
+
+    if (depth == NGX_RADIX_STRIDE) {
+
+        if (node->left == NULL && node->right == NULL) {
+            ctx->table[offset + index] = value;
+            return;
+        }
+
+        /* the next level table */
+
+        n = ctx->ntables++ << NGX_RADIX_STRIDE;
+
+        ctx->table[offset + index] = NGX_RADIX_TABLE | n;
+
+        offset = n;
+        depth = 0;
+        index = 0;
+    }
+
+    ngx_radix_compile_node(ctx, node->left, depth + 1, index << 1, value,
+                           offset);
+    ngx_radix_compile_node(ctx, node->right, depth + 1, (index << 1) + 1,
+                           value, offset);
+}
+
+
 static void *ngx_radix_alloc(ngx_radix_tree_t *tree, size_t size)
 {
     char  *p;
@@ -7,8 +7,12 @@
  * 基数是一种二叉查找树。
  * 每个节点存储的都是32位的整数类型数据。
  * 插入节点时，现将key转换为32位的二进制数据，从左往右 遇0插入左，遇1插入右
- * 
- * 没发现哪里用来啊？
+ * 值为 0 的节点表示没有值，查找时返回最长的有值的前缀的值
+ *
+ * access 模块用它保存 allow/deny 规则
+ *
+ * 插入完成后可以用 ngx_radix_tree_compile() 把树编译成每层 8 位的多路表，
+ * 表是连续的数组，查找 32 位的 key 最多读 4 次表，128 位的 key 最多读 16 次
  */
 
 #ifndef _NGX_RADIX_TREE_H_INCLUDED_
@@ -42,15 +46,39 @@ typedef struct {
     char              *start;
     // 已经分配但是没有使用的内存大小
     size_t             size;
+
+    // table 为编译出来的多路表，插入和删除后失效，为 NULL 时查找二叉树
+    uint32_t          *table;
+    // values 为表中的值的索引对应的值，索引 0 表示没有值
+    uintptr_t         *values;
 } ngx_radix_tree_t;
 
 
+/*
+ * the compiled table entry is either the index of the value or,
+ * if NGX_RADIX_TABLE bit is set, the offset of the next level table
+ */
+
+#define NGX_RADIX_STRIDE  8
+#define NGX_RADIX_TABLE   0x80000000
+
+
 ngx_radix_tree_t *ngx_radix_tree_create(ngx_pool_t *pool);
+ngx_int_t ngx_radix_tree_compile(ngx_radix_tree_t *tree);
+
 ngx_int_t ngx_radix32tree_insert(ngx_radix_tree_t *tree,
                                  uint32_t key, uint32_t mask, uintptr_t value);
 ngx_int_t ngx_radix32tree_delete(ngx_radix_tree_t *tree,
                                  uint32_t key, uint32_t mask);
 uintptr_t ngx_radix32tree_find(ngx_radix_tree_t *tree, uint32_t key);
 
+/* the 128-bit keys and masks are 16 bytes in the network byte order */
+
+ngx_int_t ngx_radix128tree_insert(ngx_radix_tree_t *tree,
+                                  u_char *key, u_char *mask, uintptr_t value);
+ngx_int_t ngx_radix128tree_delete(ngx_radix_tree_t *tree,
+                                  u_char *key, u_char *mask);
+uintptr_t ngx_radix128tree_find(ngx_radix_tree_t *tree, u_char *key);
+
 
 #endif /* _NGX_RADIX_TREE_H_INCLUDED_ */
@@ -8,12 +8,24 @@
 #include <ngx_core.h>
 
 
+static ngx_regex_t *ngx_regex_create(pcre *code, ngx_str_t *pattern,
+                                     ngx_int_t options, ngx_pool_t *pool,
+                                     ngx_str_t *err);
+static ngx_int_t ngx_regex_literal_prefix(ngx_regex_t *re, ngx_str_t *pattern,
+                                          ngx_pool_t *pool);
+#if (NGX_REGEX_STAT) || defined(PCRE_STUDY_JIT_COMPILE)
+static void ngx_regex_cleanup(void *data);
+#endif
 static void *ngx_regex_malloc(size_t size);
 static void ngx_regex_free(void *p);
 
 
 static ngx_pool_t  *ngx_pcre_pool;
 
+#if (NGX_REGEX_STAT)
+ngx_regex_t        *ngx_regexes;
+#endif
+
 
 void ngx_regex_init()
 {
@@ -27,6 +39,7 @@ ngx_regex_t *ngx_regex_compile(ngx_str_t *pattern, ngx_int_t options,
 {
     int              erroff;
     const char      *errstr;
+    pcre            *code;
     ngx_regex_t     *re;
 #if (NGX_THREADS)
     ngx_core_tls_t  *tls;
@@ -48,10 +61,15 @@ ngx_regex_t *ngx_regex_compile(ngx_str_t *pattern, ngx_int_t options,
 
 #endif
 
-    re = pcre_compile((const char *) pattern->data, (int) options,
-                      &errstr, &erroff, NULL);
+    re = NULL;
+
+    code = pcre_compile((const char *) pattern->data, (int) options,
+                        &errstr, &erroff, NULL);
 
-    if (re == NULL) {
+    if (code) {
+        re = ngx_regex_create(code, pattern, options, pool, err);
+
+    } else {
        if ((size_t) erroff == pattern->len) {
            ngx_snprintf((char *) err->data, err->len - 1,
                         "pcre_compile() failed: %s in \"%s\"",
@@ -79,22 +97,233 @@ ngx_regex_t *ngx_regex_compile(ngx_str_t *pattern, ngx_int_t options,
 }
 
 
+/*
+ * the regex is studied and compiled by the PCRE JIT if the library
+ * supports it, the PCRE 8.20+ allocates the JIT code outside the pool
+ * so it is freed by the pool cleanup
+ */
+
+static ngx_regex_t *ngx_regex_create(pcre *code, ngx_str_t *pattern,
+                                     ngx_int_t options, ngx_pool_t *pool,
+                                     ngx_str_t *err)
+{
+    const char   *errstr;
+    ngx_regex_t  *re;
+
+    if (!(re = ngx_pcalloc(pool, sizeof(ngx_regex_t)))) {
+        goto failed;
+    }
+
+    re->code = code;
+    re->caseless = (options & NGX_REGEX_CASELESS) ? 1 : 0;
+
+#ifdef PCRE_STUDY_JIT_COMPILE
+    re->extra = pcre_study(code, PCRE_STUDY_JIT_COMPILE, &errstr);
+#else
+    re->extra = pcre_study(code, 0, &errstr);
+#endif
+
+    if (errstr) {
+        ngx_snprintf((char *) err->data, err->len - 1,
+                     "pcre_study() failed: %s in \"%s\"",
+                     errstr, pattern->data);
+        return NULL;
+    }
+
+#if (NGX_REGEX_STAT) || defined(PCRE_STUDY_JIT_COMPILE)
+
+    if (ngx_pool_cleanup_add(pool, ngx_regex_cleanup, re) == NGX_ERROR) {
+        goto failed;
+    }
+
+#endif
+
+    if (ngx_regex_literal_prefix(re, pattern, pool) == NGX_ERROR) {
+        goto failed;
+    }
+
+#if (NGX_REGEX_STAT)
+
+    re->pattern = *pattern;
+
+    re->next = ngx_regexes;
+    ngx_regexes = re;
+
+#endif
+
+    return re;
+
+failed:
+
+    ngx_snprintf((char *) err->data, err->len - 1,
+                 "can not allocate the regex \"%s\"", pattern->data);
+
+    return NULL;
+}
+
+
+/*
+ * the literal characters that follow "^" must start the subject,
+ * so the subjects that do not start with them are declined without
+ * pcre_exec(); the regex with "|" has no such prefix
+ */
+
+static ngx_int_t ngx_regex_literal_prefix(ngx_regex_t *re, ngx_str_t *pattern,
+                                          ngx_pool_t *pool)
+{
+    u_char      *p, *last, *prefix;
+    size_t       len;
+    ngx_uint_t   n;
+
+    if (pattern->len < 2 || pattern->data[0] != '^') {
+        return NGX_OK;
+    }
+
+    last = pattern->data + pattern->len;
+
+    for (p = pattern->data; p < last; p++) {
+        if (*p == '|') {
+            return NGX_OK;
+        }
+    }
+
+    if (!(prefix = ngx_palloc(pool, pattern->len))) {
+        return NGX_ERROR;
+    }
+
+    len = 0;
+
+    /* n is the length of the last literal in the pattern */
+
+    n = 0;
+
+    for (p = pattern->data + 1; p < last; p += n) {
+
+        switch (*p) {
+
+        case '.': case '[': case ']': case '(': case ')':
+        case '^': case '$': case '*': case '+': case '?':
+        case '{': case '}':
+            break;
+
+        case '\\':
+            if (p + 1 < last
+                && !(p[1] >= 'a' && p[1] <= 'z')
+                && !(p[1] >= 'A' && p[1] <= 'Z')
+                && !(p[1] >= '0' && p[1] <= '9'))
+            {
+                prefix[len++] = p[1];
+                n = 2;
+                continue;
+            }
+
+            break;
+
+        default:
+            prefix[len++] = *p;
+            n = 1;
+            continue;
+        }
+
+        break;
+    }
+
+    /* the quantified literal may be absent */
+
+    if (p < last && len && (*p == '*' || *p == '?' || *p == '{')) {
+        len--;
+    }
+
+    if (len) {
+        re->prefix = prefix;
+        re->prefix_len = len;
+    }
+
+    return NGX_OK;
+}
+
+
 ngx_int_t ngx_regex_exec(ngx_regex_t *re, ngx_str_t *s,
                          int *matches, ngx_int_t size)
 {
-    int  rc;
+    int              rc;
+#if (NGX_REGEX_STAT)
+    struct timeval   start, end;
+
+    re->execs++;
+#endif
 
-    rc = pcre_exec(re, NULL, (const char *) s->data, s->len, 0, 0,
+    if (re->prefix_len
+        && (s->len < re->prefix_len
+            || (re->caseless ?
+                    ngx_memcasecmp(s->data, re->prefix, re->prefix_len):
+                    ngx_strncmp(s->data, re->prefix, re->prefix_len))))
+    {
+#if (NGX_REGEX_STAT)
+        re->skips++;
+#endif
+        return NGX_DECLINED;
+    }
+
+#if (NGX_REGEX_STAT)
+    ngx_gettimeofday(&start);
+#endif
+
+    rc = pcre_exec(re->code, re->extra, (const char *) s->data, s->len, 0, 0,
                    matches, size);
 
+#if (NGX_REGEX_STAT)
+    ngx_gettimeofday(&end);
+
+    re->usec += (end.tv_sec - start.tv_sec) * 1000000
+                + (end.tv_usec - start.tv_usec);
+#endif
+
     if (rc == -1) {
         return NGX_DECLINED;
     }
 
+#if (NGX_REGEX_STAT)
+    if (rc >= 0) {
+        re->matches++;
+    }
+#endif
+
     return rc;
 }
 
 
+#if (NGX_REGEX_STAT) || defined(PCRE_STUDY_JIT_COMPILE)
+
+static void ngx_regex_cleanup(void *data)
+{
+    ngx_regex_t   *re;
+#if (NGX_REGEX_STAT)
+    ngx_regex_t  **rp;
+#endif
+
+    re = data;
+
+#ifdef PCRE_STUDY_JIT_COMPILE
+    if (re->extra) {
+        pcre_free_study(re->extra);
+        re->extra = NULL;
+    }
+#endif
+
+#if (NGX_REGEX_STAT)
+    for (rp = &ngx_regexes; *rp; rp = &(*rp)->next) {
+        if (*rp == re) {
+            *rp = re->next;
+            break;
+        }
+    }
+#endif
+}
+
+#endif
+
+
 static void *ngx_regex_malloc(size_t size)
 {
     ngx_pool_t      *pool;
@@ -16,7 +16,30 @@
 
 #define NGX_REGEX_CASELESS  PCRE_CASELESS
 
-typedef pcre  ngx_regex_t;
+
+typedef struct ngx_regex_s  ngx_regex_t;
+
+struct ngx_regex_s {
+    pcre         *code;
+    pcre_extra   *extra;
+
+    /* the literal prefix of the "^..." regex, the subject must start with */
+    u_char       *prefix;
+    size_t        prefix_len;
+    ngx_uint_t    caseless;     /* unsigned  caseless:1; */
+
+#if (NGX_REGEX_STAT)
+    ngx_str_t     pattern;
+
+    ngx_uint_t    execs;
+    ngx_uint_t    skips;
+    ngx_uint_t    matches;
+    ngx_uint_t    usec;
+
+    ngx_regex_t  *next;
+#endif
+};
+
 
 void ngx_regex_init();
 ngx_regex_t *ngx_regex_compile(ngx_str_t *pattern, ngx_int_t options,
@@ -27,4 +50,15 @@ ngx_int_t ngx_regex_exec(ngx_regex_t *re, ngx_str_t *s,
 #define ngx_regex_exec_n  "pcre_exec()"
 
 
+#if (NGX_REGEX_STAT)
+
+/*
+ * the regexes of the current configuration, the counters are per process
+ */
+
+extern ngx_regex_t  *ngx_regexes;
+
+#endif
+
+
 #endif /* _NGX_REGEX_H_INCLUDED_ */
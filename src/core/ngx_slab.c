@@ -3,10 +3,792 @@
  * Copyright (C) Igor Sysoev
  */
 
-// 没有实现？
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+/*
+ * The shared memory zone is split into pages.  Each page either belongs
+ * to a run of the free pages, or is allocated as a whole (for the requests
+ * bigger than a half of page), or is sliced into the equal chunks
+ * of the one size class.  The chunks bitmap is stored:
+ *
+ *   NGX_SLAB_SMALL  - in the first chunks of the page itself,
+ *   NGX_SLAB_EXACT  - in the page descriptor "slab" field,
+ *   NGX_SLAB_BIG    - in the high 16 bits of the "slab" field.
+ *
+ * The bitmaps are always 32-bit wide so the layout does not depend
+ * on the pointer size.
+ */
+
+
+#define NGX_SLAB_PAGE_MASK   3
+#define NGX_SLAB_PAGE        0
+#define NGX_SLAB_BIG         1
+#define NGX_SLAB_EXACT       2
+#define NGX_SLAB_SMALL       3
+
+#define NGX_SLAB_PAGE_FREE   0
+#define NGX_SLAB_PAGE_BUSY   0xffffffff
+#define NGX_SLAB_PAGE_START  0x80000000
+
+#define NGX_SLAB_SHIFT_MASK  0x0000000f
+#define NGX_SLAB_MAP_MASK    0xffff0000
+#define NGX_SLAB_MAP_SHIFT   16
+
+#define NGX_SLAB_BUSY        0xffffffff
+#define NGX_SLAB_MAP_BITS    32
+
+
+#define ngx_slab_slots(pool)                                                  \
+    (ngx_slab_page_t *) ((u_char *) (pool) + sizeof(ngx_slab_pool_t))
+
+#define ngx_slab_page_type(page)   ((page)->prev & NGX_SLAB_PAGE_MASK)
+
+#define ngx_slab_page_prev(page)                                              \
+    (ngx_slab_page_t *) ((page)->prev & ~NGX_SLAB_PAGE_MASK)
+
+#define ngx_slab_page_addr(pool, page)                                        \
+    ((((page) - (pool)->pages) << ngx_pagesize_shift)                         \
+     + (uintptr_t) (pool)->start)
+
+
+static ngx_slab_page_t *ngx_slab_alloc_pages(ngx_slab_pool_t *pool,
+                                             ngx_uint_t pages);
+static void ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
+                                ngx_uint_t pages);
+static void ngx_slab_error(ngx_slab_pool_t *pool, ngx_uint_t level,
+                           char *text);
+
+
+static ngx_uint_t  ngx_slab_max_size;
+static ngx_uint_t  ngx_slab_exact_size;
+static ngx_uint_t  ngx_slab_exact_shift;
+
+
+ngx_slab_pool_t *ngx_slab_create(size_t size, ngx_log_t *log)
+{
+    u_char           *shared;
+    ngx_slab_pool_t  *pool;
+
+    if (size < 8 * (size_t) ngx_pagesize) {
+        ngx_log_error(NGX_LOG_EMERG, log, 0,
+                      "shared zone size " SIZE_T_FMT " is too small", size);
+        return NULL;
+    }
+
+    if (!(shared = ngx_create_shared_memory(size, log))) {
+        return NULL;
+    }
+
+    pool = (ngx_slab_pool_t *) shared;
+
+    pool->lock = 0;
+    pool->min_shift = 3;
+    pool->end = shared + size;
+    pool->data = NULL;
+    pool->addr = shared;
+
+    ngx_slab_init(pool);
+
+    return pool;
+}
+
+
+void ngx_slab_init(ngx_slab_pool_t *pool)
+{
+    u_char           *p;
+    size_t            size;
+    ngx_int_t         m;
+    ngx_uint_t        i, n, pages;
+    ngx_slab_page_t  *slots, *page;
+
+    if (ngx_slab_max_size == 0) {
+        ngx_slab_max_size = ngx_pagesize / 2;
+        ngx_slab_exact_size = ngx_pagesize / NGX_SLAB_MAP_BITS;
+        for (n = ngx_slab_exact_size; n >>= 1; ngx_slab_exact_shift++) {
+            /* void */
+        }
+    }
+
+    pool->min_size = (size_t) 1 << pool->min_shift;
+
+    slots = ngx_slab_slots(pool);
+
+    p = (u_char *) slots;
+    size = pool->end - p;
+
+    n = ngx_pagesize_shift - pool->min_shift;
+
+    for (i = 0; i < n; i++) {
+
+        /* only "next" is used in the list head */
+
+        slots[i].slab = 0;
+        slots[i].next = &slots[i];
+        slots[i].prev = 0;
+    }
+
+    p += n * sizeof(ngx_slab_page_t);
+
+    pool->stats = (ngx_slab_stat_t *) p;
+    ngx_memzero(pool->stats, n * sizeof(ngx_slab_stat_t));
+
+    p += n * sizeof(ngx_slab_stat_t);
+
+    size -= n * (sizeof(ngx_slab_page_t) + sizeof(ngx_slab_stat_t));
+
+    pages = (ngx_uint_t) (size / (ngx_pagesize + sizeof(ngx_slab_page_t)));
+
+    pool->pages = (ngx_slab_page_t *) p;
+    ngx_memzero(pool->pages, pages * sizeof(ngx_slab_page_t));
+
+    page = pool->pages;
+
+    pool->free.slab = 0;
+    pool->free.next = page;
+    pool->free.prev = 0;
+
+    page->slab = pages;
+    page->next = &pool->free;
+    page->prev = (uintptr_t) &pool->free;
+
+    p += pages * sizeof(ngx_slab_page_t);
+
+    pool->start = (u_char *) (((uintptr_t) p + ngx_pagesize - 1)
+                              & ~((uintptr_t) ngx_pagesize - 1));
+
+    m = pages - (pool->end - pool->start) / ngx_pagesize;
+    if (m > 0) {
+        pages -= m;
+        page->slab = pages;
+    }
+
+    pool->last = pool->pages + pages;
+    pool->pfree = pages;
+
+    pool->log_nomem = 1;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                   "slab init: " PTR_FMT ", pages: %d, start: " PTR_FMT,
+                   pool, pages, pool->start);
+}
 
 
 void *ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size)
 {
-   return NULL;
+    void  *p;
+
+    ngx_slab_lock(pool);
+
+    p = ngx_slab_alloc_locked(pool, size);
+
+    ngx_slab_unlock(pool);
+
+    return p;
+}
+
+
+void *ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
+{
+    size_t            s;
+    uint32_t          m, mask, *bitmap;
+    uintptr_t         p;
+    ngx_uint_t        i, n, slot, shift, map;
+    ngx_slab_page_t  *page, *prev, *slots;
+
+    if (size > ngx_slab_max_size) {
+
+        ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                       "slab alloc: " SIZE_T_FMT, size);
+
+        page = ngx_slab_alloc_pages(pool, (size >> ngx_pagesize_shift)
+                                          + ((size % ngx_pagesize) ? 1 : 0));
+        if (page) {
+            p = ngx_slab_page_addr(pool, page);
+
+        } else {
+            p = 0;
+        }
+
+        goto done;
+    }
+
+    if (size > pool->min_size) {
+        shift = 1;
+        for (s = size - 1; s >>= 1; shift++) { /* void */ }
+        slot = shift - pool->min_shift;
+
+    } else {
+        shift = pool->min_shift;
+        slot = 0;
+    }
+
+    pool->stats[slot].reqs++;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                   "slab alloc: " SIZE_T_FMT " slot: %d", size, slot);
+
+    slots = ngx_slab_slots(pool);
+    page = slots[slot].next;
+
+    if (page->next != page) {
+
+        if (shift < ngx_slab_exact_shift) {
+
+            bitmap = (uint32_t *) ngx_slab_page_addr(pool, page);
+
+            map = (ngx_pagesize >> shift) / NGX_SLAB_MAP_BITS;
+
+            for (n = 0; n < map; n++) {
+
+                if (bitmap[n] == NGX_SLAB_BUSY) {
+                    continue;
+                }
+
+                for (m = 1, i = 0; m; m <<= 1, i++) {
+                    if (bitmap[n] & m) {
+                        continue;
+                    }
+
+                    bitmap[n] |= m;
+
+                    i = (n * NGX_SLAB_MAP_BITS + i) << shift;
+
+                    p = (uintptr_t) bitmap + i;
+
+                    pool->stats[slot].used++;
+
+                    if (bitmap[n] == NGX_SLAB_BUSY) {
+                        for (n = n + 1; n < map; n++) {
+                            if (bitmap[n] != NGX_SLAB_BUSY) {
+                                goto done;
+                            }
+                        }
+
+                        prev = ngx_slab_page_prev(page);
+                        prev->next = page->next;
+                        page->next->prev = page->prev;
+
+                        page->next = NULL;
+                        page->prev = NGX_SLAB_SMALL;
+                    }
+
+                    goto done;
+                }
+            }
+
+        } else if (shift == ngx_slab_exact_shift) {
+
+            for (m = 1, i = 0; m; m <<= 1, i++) {
+                if (page->slab & m) {
+                    continue;
+                }
+
+                page->slab |= m;
+
+                if (page->slab == NGX_SLAB_BUSY) {
+                    prev = ngx_slab_page_prev(page);
+                    prev->next = page->next;
+                    page->next->prev = page->prev;
+
+                    page->next = NULL;
+                    page->prev = NGX_SLAB_EXACT;
+                }
+
+                p = ngx_slab_page_addr(pool, page) + (i << shift);
+
+                pool->stats[slot].used++;
+
+                goto done;
+            }
+
+        } else { /* shift > ngx_slab_exact_shift */
+
+            mask = ((uint32_t) 1 << (ngx_pagesize >> shift)) - 1;
+            mask <<= NGX_SLAB_MAP_SHIFT;
+
+            for (m = (uint32_t) 1 << NGX_SLAB_MAP_SHIFT, i = 0;
+                 m & mask;
+                 m <<= 1, i++)
+            {
+                if (page->slab & m) {
+                    continue;
+                }
+
+                page->slab |= m;
+
+                if ((page->slab & NGX_SLAB_MAP_MASK) == mask) {
+                    prev = ngx_slab_page_prev(page);
+                    prev->next = page->next;
+                    page->next->prev = page->prev;
+
+                    page->next = NULL;
+                    page->prev = NGX_SLAB_BIG;
+                }
+
+                p = ngx_slab_page_addr(pool, page) + (i << shift);
+
+                pool->stats[slot].used++;
+
+                goto done;
+            }
+        }
+
+        ngx_slab_error(pool, NGX_LOG_ALERT, "ngx_slab_alloc(): page is busy");
+    }
+
+    page = ngx_slab_alloc_pages(pool, 1);
+
+    if (page) {
+        if (shift < ngx_slab_exact_shift) {
+            bitmap = (uint32_t *) ngx_slab_page_addr(pool, page);
+
+            /* the number of chunks occupied by the bitmap itself */
+
+            n = (ngx_pagesize >> shift) / ((1 << shift) * 8);
+
+            if (n == 0) {
+                n = 1;
+            }
+
+            /* "n" chunks for the bitmap, plus the requested one */
+
+            for (i = 0; i < (n + 1) / NGX_SLAB_MAP_BITS; i++) {
+                bitmap[i] = NGX_SLAB_BUSY;
+            }
+
+            m = ((uint32_t) 1 << ((n + 1) % NGX_SLAB_MAP_BITS)) - 1;
+            bitmap[i] = m;
+
+            map = (ngx_pagesize >> shift) / NGX_SLAB_MAP_BITS;
+
+            for (i = i + 1; i < map; i++) {
+                bitmap[i] = 0;
+            }
+
+            page->slab = shift;
+            page->next = &slots[slot];
+            page->prev = (uintptr_t) &slots[slot] | NGX_SLAB_SMALL;
+
+            slots[slot].next = page;
+
+            pool->stats[slot].total += (ngx_pagesize >> shift) - n;
+
+            p = ngx_slab_page_addr(pool, page) + (n << shift);
+
+        } else if (shift == ngx_slab_exact_shift) {
+
+            page->slab = 1;
+            page->next = &slots[slot];
+            page->prev = (uintptr_t) &slots[slot] | NGX_SLAB_EXACT;
+
+            slots[slot].next = page;
+
+            pool->stats[slot].total += NGX_SLAB_MAP_BITS;
+
+            p = ngx_slab_page_addr(pool, page);
+
+        } else { /* shift > ngx_slab_exact_shift */
+
+            page->slab = ((uintptr_t) 1 << NGX_SLAB_MAP_SHIFT) | shift;
+            page->next = &slots[slot];
+            page->prev = (uintptr_t) &slots[slot] | NGX_SLAB_BIG;
+
+            slots[slot].next = page;
+
+            pool->stats[slot].total += ngx_pagesize >> shift;
+
+            p = ngx_slab_page_addr(pool, page);
+        }
+
+        pool->stats[slot].used++;
+
+        goto done;
+    }
+
+    p = 0;
+
+    pool->stats[slot].fails++;
+
+done:
+
+    ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                   "slab alloc: " PTR_FMT, (void *) p);
+
+    return (void *) p;
+}
+
+
+void *ngx_slab_calloc(ngx_slab_pool_t *pool, size_t size)
+{
+    void  *p;
+
+    ngx_slab_lock(pool);
+
+    p = ngx_slab_alloc_locked(pool, size);
+    if (p) {
+        ngx_memzero(p, size);
+    }
+
+    ngx_slab_unlock(pool);
+
+    return p;
+}
+
+
+void ngx_slab_free(ngx_slab_pool_t *pool, void *p)
+{
+    ngx_slab_lock(pool);
+
+    ngx_slab_free_locked(pool, p);
+
+    ngx_slab_unlock(pool);
+}
+
+
+void ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
+{
+    size_t            size;
+    uint32_t          m, *bitmap;
+    uintptr_t         slab;
+    ngx_uint_t        i, n, type, slot, shift, map;
+    ngx_slab_page_t  *slots, *page;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                   "slab free: " PTR_FMT, p);
+
+    if ((u_char *) p < pool->start || (u_char *) p >= pool->end) {
+        ngx_slab_error(pool, NGX_LOG_ALERT, "ngx_slab_free(): outside of pool");
+        return;
+    }
+
+    n = ((u_char *) p - pool->start) >> ngx_pagesize_shift;
+    page = &pool->pages[n];
+    slab = page->slab;
+    type = ngx_slab_page_type(page);
+
+    switch (type) {
+
+    case NGX_SLAB_SMALL:
+
+        shift = slab & NGX_SLAB_SHIFT_MASK;
+        size = (size_t) 1 << shift;
+
+        if ((uintptr_t) p & (size - 1)) {
+            goto wrong_chunk;
+        }
+
+        n = ((uintptr_t) p & (ngx_pagesize - 1)) >> shift;
+        m = (uint32_t) 1 << (n % NGX_SLAB_MAP_BITS);
+        n /= NGX_SLAB_MAP_BITS;
+        bitmap = (uint32_t *) ((uintptr_t) p & ~((uintptr_t) ngx_pagesize - 1));
+
+        if (!(bitmap[n] & m)) {
+            goto chunk_already_free;
+        }
+
+        slot = shift - pool->min_shift;
+
+        if (page->next == NULL) {
+            slots = ngx_slab_slots(pool);
+
+            page->next = slots[slot].next;
+            slots[slot].next = page;
+
+            page->prev = (uintptr_t) &slots[slot] | NGX_SLAB_SMALL;
+            page->next->prev = (uintptr_t) page | NGX_SLAB_SMALL;
+        }
+
+        bitmap[n] &= ~m;
+
+        n = (ngx_pagesize >> shift) / ((1 << shift) * 8);
+
+        if (n == 0) {
+            n = 1;
+        }
+
+        i = n / NGX_SLAB_MAP_BITS;
+        m = ((uint32_t) 1 << (n % NGX_SLAB_MAP_BITS)) - 1;
+
+        if (bitmap[i] & ~m) {
+            goto done;
+        }
+
+        map = (ngx_pagesize >> shift) / NGX_SLAB_MAP_BITS;
+
+        for (i = i + 1; i < map; i++) {
+            if (bitmap[i]) {
+                goto done;
+            }
+        }
+
+        ngx_slab_free_pages(pool, page, 1);
+
+        pool->stats[slot].total -= (ngx_pagesize >> shift) - n;
+
+        goto done;
+
+    case NGX_SLAB_EXACT:
+
+        m = (uint32_t) 1 <<
+                (((uintptr_t) p & (ngx_pagesize - 1)) >> ngx_slab_exact_shift);
+        size = ngx_slab_exact_size;
+
+        if ((uintptr_t) p & (size - 1)) {
+            goto wrong_chunk;
+        }
+
+        if (!(slab & m)) {
+            goto chunk_already_free;
+        }
+
+        slot = ngx_slab_exact_shift - pool->min_shift;
+
+        if (slab == NGX_SLAB_BUSY) {
+            slots = ngx_slab_slots(pool);
+
+            page->next = slots[slot].next;
+            slots[slot].next = page;
+
+            page->prev = (uintptr_t) &slots[slot] | NGX_SLAB_EXACT;
+            page->next->prev = (uintptr_t) page | NGX_SLAB_EXACT;
+        }
+
+        page->slab &= ~m;
+
+        if (page->slab) {
+            goto done;
+        }
+
+        ngx_slab_free_pages(pool, page, 1);
+
+        pool->stats[slot].total -= NGX_SLAB_MAP_BITS;
+
+        goto done;
+
+    case NGX_SLAB_BIG:
+
+        shift = slab & NGX_SLAB_SHIFT_MASK;
+        size = (size_t) 1 << shift;
+
+        if ((uintptr_t) p & (size - 1)) {
+            goto wrong_chunk;
+        }
+
+        m = (uint32_t) 1 << ((((uintptr_t) p & (ngx_pagesize - 1)) >> shift)
+                             + NGX_SLAB_MAP_SHIFT);
+
+        if (!(slab & m)) {
+            goto chunk_already_free;
+        }
+
+        slot = shift - pool->min_shift;
+
+        if (page->next == NULL) {
+            slots = ngx_slab_slots(pool);
+
+            page->next = slots[slot].next;
+            slots[slot].next = page;
+
+            page->prev = (uintptr_t) &slots[slot] | NGX_SLAB_BIG;
+            page->next->prev = (uintptr_t) page | NGX_SLAB_BIG;
+        }
+
+        page->slab &= ~m;
+
+        if (page->slab & NGX_SLAB_MAP_MASK) {
+            goto done;
+        }
+
+        ngx_slab_free_pages(pool, page, 1);
+
+        pool->stats[slot].total -= ngx_pagesize >> shift;
+
+        goto done;
+
+    case NGX_SLAB_PAGE:
+
+        if ((uintptr_t) p & (ngx_pagesize - 1)) {
+            goto wrong_chunk;
+        }
+
+        if (!(slab & NGX_SLAB_PAGE_START)) {
+            ngx_slab_error(pool, NGX_LOG_ALERT,
+                           "ngx_slab_free(): page is already free");
+            return;
+        }
+
+        if (slab == NGX_SLAB_PAGE_BUSY) {
+            ngx_slab_error(pool, NGX_LOG_ALERT,
+                           "ngx_slab_free(): pointer to wrong page");
+            return;
+        }
+
+        ngx_slab_free_pages(pool, page, slab & ~NGX_SLAB_PAGE_START);
+
+        return;
+    }
+
+    /* not reached */
+
+    return;
+
+done:
+
+    pool->stats[slot].used--;
+
+    return;
+
+wrong_chunk:
+
+    ngx_slab_error(pool, NGX_LOG_ALERT,
+                   "ngx_slab_free(): pointer to wrong chunk");
+    return;
+
+chunk_already_free:
+
+    ngx_slab_error(pool, NGX_LOG_ALERT,
+                   "ngx_slab_free(): chunk is already free");
+}
+
+
+static ngx_slab_page_t *ngx_slab_alloc_pages(ngx_slab_pool_t *pool,
+                                             ngx_uint_t pages)
+{
+    ngx_slab_page_t  *page, *p;
+
+    for (page = pool->free.next; page != &pool->free; page = page->next) {
+
+        if (page->slab < pages) {
+            continue;
+        }
+
+        if (page->slab > pages) {
+            page[page->slab - 1].prev = (uintptr_t) &page[pages];
+
+            page[pages].slab = page->slab - pages;
+            page[pages].next = page->next;
+            page[pages].prev = page->prev;
+
+            p = (ngx_slab_page_t *) page->prev;
+            p->next = &page[pages];
+            page->next->prev = (uintptr_t) &page[pages];
+
+        } else {
+            p = (ngx_slab_page_t *) page->prev;
+            p->next = page->next;
+            page->next->prev = page->prev;
+        }
+
+        page->slab = pages | NGX_SLAB_PAGE_START;
+        page->next = NULL;
+        page->prev = NGX_SLAB_PAGE;
+
+        pool->pfree -= pages;
+
+        for (p = page + 1; --pages; p++) {
+            p->slab = NGX_SLAB_PAGE_BUSY;
+            p->next = NULL;
+            p->prev = NGX_SLAB_PAGE;
+        }
+
+        return page;
+    }
+
+    if (pool->log_nomem) {
+        ngx_slab_error(pool, NGX_LOG_CRIT, "ngx_slab_alloc() failed: no memory");
+    }
+
+    return NULL;
+}
+
+
+static void ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
+                                ngx_uint_t pages)
+{
+    ngx_slab_page_t  *prev, *join;
+
+    pool->pfree += pages;
+
+    page->slab = pages--;
+
+    if (pages) {
+        ngx_memzero(&page[1], pages * sizeof(ngx_slab_page_t));
+    }
+
+    if (page->next) {
+        prev = ngx_slab_page_prev(page);
+        prev->next = page->next;
+        page->next->prev = page->prev;
+    }
+
+    /* coalesce with the following run of the free pages */
+
+    join = page + page->slab;
+
+    if (join < pool->last
+        && ngx_slab_page_type(join) == NGX_SLAB_PAGE
+        && join->next != NULL)
+    {
+        pages += join->slab;
+        page->slab += join->slab;
+
+        prev = ngx_slab_page_prev(join);
+        prev->next = join->next;
+        join->next->prev = join->prev;
+
+        join->slab = NGX_SLAB_PAGE_FREE;
+        join->next = NULL;
+        join->prev = NGX_SLAB_PAGE;
+    }
+
+    /* coalesce with the preceding run of the free pages */
+
+    if (page > pool->pages) {
+        join = page - 1;
+
+        if (ngx_slab_page_type(join) == NGX_SLAB_PAGE) {
+
+            if (join->slab == NGX_SLAB_PAGE_FREE) {
+                join = ngx_slab_page_prev(join);
+            }
+
+            if (join && join->next != NULL) {
+                pages += join->slab;
+                join->slab += page->slab;
+
+                prev = ngx_slab_page_prev(join);
+                prev->next = join->next;
+                join->next->prev = join->prev;
+
+                page->slab = NGX_SLAB_PAGE_FREE;
+                page->next = NULL;
+                page->prev = NGX_SLAB_PAGE;
+
+                page = join;
+            }
+        }
+    }
+
+    /* the last page of a run points to its first page */
+
+    if (pages) {
+        page[pages].prev = (uintptr_t) page;
+    }
+
+    page->prev = (uintptr_t) &pool->free;
+    page->next = pool->free.next;
+
+    page->next->prev = (uintptr_t) page;
+
+    pool->free.next = page;
+}
+
+
+static void ngx_slab_error(ngx_slab_pool_t *pool, ngx_uint_t level,
+                           char *text)
+{
+    ngx_log_error(level, ngx_cycle->log, 0, "%s, zone: " PTR_FMT, text, pool);
 }
@@ -12,32 +12,61 @@
 #include <ngx_core.h>
 
 
-typedef struct ngx_free_slab_s  ngx_free_slab_t;
+typedef struct ngx_slab_page_s  ngx_slab_page_t;
 
-typedef struct ngx_free_slab_s {
-    ngx_free_slab_t  *next;
-}
+struct ngx_slab_page_s {
+    uintptr_t         slab;
+    ngx_slab_page_t  *next;
+    uintptr_t         prev;
+};
 
 
-typedef struct ngx_slab_block_s  ngx_slab_block_t;
+typedef struct {
+    ngx_uint_t        total;
+    ngx_uint_t        used;
 
-typedef struct ngx_slab_block_s {
-    ngx_free_slab_t  *free;
-    ngx_slab_buf_t   *next;
-    size_t            color;
-};
+    ngx_uint_t        reqs;
+    ngx_uint_t        fails;
+} ngx_slab_stat_t;
 
 
 typedef struct {
-    ngx_slab_buf_t   *blocks;
-    size_t            size;
+    ngx_atomic_t      lock;
+
+    size_t            min_size;
+    size_t            min_shift;
+
+    ngx_slab_page_t  *pages;
+    ngx_slab_page_t  *last;
+    ngx_slab_page_t   free;
+
+    ngx_slab_stat_t  *stats;
+    ngx_uint_t        pfree;
+
+    u_char           *start;
+    u_char           *end;
 
-    void             *start;
-    uint32_t          map;
+    ngx_uint_t        log_nomem;   /* unsigned  log_nomem:1; */
 
-    ngx_log_t        *log;
-    ngx_free_pool_t   free;
+    void             *data;
+    void             *addr;
 } ngx_slab_pool_t;
 
 
+#define NGX_SLAB_SPIN  1024
+
+
+ngx_slab_pool_t *ngx_slab_create(size_t size, ngx_log_t *log);
+void ngx_slab_init(ngx_slab_pool_t *pool);
+void *ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size);
+void *ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size);
+void *ngx_slab_calloc(ngx_slab_pool_t *pool, size_t size);
+void ngx_slab_free(ngx_slab_pool_t *pool, void *p);
+void ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p);
+
+
+#define ngx_slab_lock(pool)    ngx_spinlock(&(pool)->lock, NGX_SLAB_SPIN)
+#define ngx_slab_unlock(pool)  ngx_unlock(&(pool)->lock)
+
+
 #endif /* _NGX_SLAB_H_INCLUDED_ */
@@ -8,6 +8,61 @@
 #include <ngx_core.h>
 
 
+/*
+ * the SSE2 versions are built if the compiler targets SSE2, it is always
+ * on amd64, and the AVX2 versions are built for the AVX2 target by gcc 4.9+
+ * and are used only if the CPU supports AVX2
+ */
+
+#if (__SSE2__ && __GNUC__)
+
+#include <emmintrin.h>
+
+#define NGX_HAVE_SSE2  1
+
+#if (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+
+#include <immintrin.h>
+
+#define NGX_HAVE_AVX2  1
+
+#endif
+
+#endif
+
+
+static void ngx_strlow_scalar(u_char *dst, u_char *src, size_t n);
+static ngx_int_t ngx_memcasecmp_scalar(u_char *s1, u_char *s2, size_t n);
+static u_char *ngx_strlchr_scalar(u_char *p, u_char *last, u_char c);
+static u_char *ngx_strlascii_scalar(u_char *p, u_char *last);
+
+#if (NGX_HAVE_SSE2)
+static void ngx_strlow_sse2(u_char *dst, u_char *src, size_t n);
+static ngx_int_t ngx_memcasecmp_sse2(u_char *s1, u_char *s2, size_t n);
+static u_char *ngx_strlchr_sse2(u_char *p, u_char *last, u_char c);
+static u_char *ngx_strlascii_sse2(u_char *p, u_char *last);
+#endif
+
+#if (NGX_HAVE_AVX2)
+static void ngx_strlow_avx2(u_char *dst, u_char *src, size_t n)
+    __attribute__ ((target ("avx2")));
+static ngx_int_t ngx_memcasecmp_avx2(u_char *s1, u_char *s2, size_t n)
+    __attribute__ ((target ("avx2")));
+static u_char *ngx_strlchr_avx2(u_char *p, u_char *last, u_char c)
+    __attribute__ ((target ("avx2")));
+static u_char *ngx_strlascii_avx2(u_char *p, u_char *last)
+    __attribute__ ((target ("avx2")));
+#endif
+
+
+ngx_string_ops_t  ngx_string_ops = {
+    ngx_strlow_scalar,
+    ngx_memcasecmp_scalar,
+    ngx_strlchr_scalar,
+    ngx_strlascii_scalar
+};
+
+
 u_char *ngx_cpystrn(u_char *dst, u_char *src, size_t n)
 {
     if (n == 0) {
@@ -50,6 +105,400 @@ ngx_int_t ngx_rstrncmp(u_char *s1, u_char *s2, size_t n)
 }
 
 
+ngx_uint_t ngx_string_init(ngx_uint_t simd)
+{
+#if (NGX_HAVE_AVX2)
+
+    if (simd >= NGX_STRING_AVX2 && __builtin_cpu_supports("avx2")) {
+        ngx_string_ops.strlow = ngx_strlow_avx2;
+        ngx_string_ops.memcasecmp = ngx_memcasecmp_avx2;
+        ngx_string_ops.strlchr = ngx_strlchr_avx2;
+        ngx_string_ops.strlascii = ngx_strlascii_avx2;
+
+        return NGX_STRING_AVX2;
+    }
+
+#endif
+
+#if (NGX_HAVE_SSE2)
+
+    if (simd >= NGX_STRING_SSE2) {
+        ngx_string_ops.strlow = ngx_strlow_sse2;
+        ngx_string_ops.memcasecmp = ngx_memcasecmp_sse2;
+        ngx_string_ops.strlchr = ngx_strlchr_sse2;
+        ngx_string_ops.strlascii = ngx_strlascii_sse2;
+
+        return NGX_STRING_SSE2;
+    }
+
+#endif
+
+    ngx_string_ops.strlow = ngx_strlow_scalar;
+    ngx_string_ops.memcasecmp = ngx_memcasecmp_scalar;
+    ngx_string_ops.strlchr = ngx_strlchr_scalar;
+    ngx_string_ops.strlascii = ngx_strlascii_scalar;
+
+    return NGX_STRING_SCALAR;
+}
+
+
+static void ngx_strlow_scalar(u_char *dst, u_char *src, size_t n)
+{
+    while (n--) {
+        *dst++ = ngx_tolower(*src);
+        src++;
+    }
+}
+
+
+static ngx_int_t ngx_memcasecmp_scalar(u_char *s1, u_char *s2, size_t n)
+{
+    u_char  c1, c2;
+
+    while (n--) {
+        c1 = *s1++;
+        c2 = *s2++;
+
+        c1 = ngx_tolower(c1);
+        c2 = ngx_tolower(c2);
+
+        if (c1 != c2) {
+            return c1 - c2;
+        }
+    }
+
+    return 0;
+}
+
+
+static u_char *ngx_strlchr_scalar(u_char *p, u_char *last, u_char c)
+{
+    for (/* void */; p < last; p++) {
+        if (*p == c) {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+
+static u_char *ngx_strlascii_scalar(u_char *p, u_char *last)
+{
+    for (/* void */; p < last; p++) {
+        if (*p & 0x80) {
+            return p;
+        }
+    }
+
+    return last;
+}
+
+
+#if (NGX_HAVE_SSE2)
+
+/*
+ * the uppercase letters are found by the signed comparisons,
+ * the bytes above 0x7f are negative and are not changed
+ */
+
+#define ngx_lower_sse2(v)                                                     \
+    _mm_or_si128(v, _mm_and_si128(_mm_set1_epi8(0x20),                        \
+        _mm_andnot_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('Z')),               \
+                         _mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)))))
+
+
+/*
+ * the tail of the string that is 16 bytes or longer is handled
+ * by the last 16 bytes block that overlaps the previous block
+ */
+
+static void ngx_strlow_sse2(u_char *dst, u_char *src, size_t n)
+{
+    __m128i  v;
+
+    if (n < 16) {
+        ngx_strlow_scalar(dst, src, n);
+        return;
+    }
+
+    for (/* void */; n > 16; n -= 16, src += 16, dst += 16) {
+        v = _mm_loadu_si128((__m128i *) src);
+        _mm_storeu_si128((__m128i *) dst, ngx_lower_sse2(v));
+    }
+
+    src -= 16 - n;
+    dst -= 16 - n;
+
+    v = _mm_loadu_si128((__m128i *) src);
+    _mm_storeu_si128((__m128i *) dst, ngx_lower_sse2(v));
+}
+
+
+static ngx_int_t ngx_memcasecmp_sse2(u_char *s1, u_char *s2, size_t n)
+{
+    size_t   last;
+    __m128i  v1, v2;
+
+    if (n < 16) {
+        return ngx_memcasecmp_scalar(s1, s2, n);
+    }
+
+    last = n - 16;
+
+    for (n = 0; /* void */; n += 16) {
+
+        if (n > last) {
+            n = last;
+        }
+
+        v1 = _mm_loadu_si128((__m128i *) (s1 + n));
+        v2 = _mm_loadu_si128((__m128i *) (s2 + n));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(ngx_lower_sse2(v1),
+                                             ngx_lower_sse2(v2)))
+            != 0xffff)
+        {
+            return ngx_memcasecmp_scalar(s1 + n, s2 + n, 16);
+        }
+
+        if (n == last) {
+            return 0;
+        }
+    }
+}
+
+
+static u_char *ngx_strlchr_sse2(u_char *p, u_char *last, u_char c)
+{
+    int      mask;
+    __m128i  v, s;
+
+    if (last - p < 16) {
+        return ngx_strlchr_scalar(p, last, c);
+    }
+
+    s = _mm_set1_epi8(c);
+
+    for ( ;; ) {
+
+        if (last - p < 16) {
+            p = last - 16;
+        }
+
+        v = _mm_loadu_si128((__m128i *) p);
+
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, s));
+
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+
+        if (p == last - 16) {
+            return NULL;
+        }
+
+        p += 16;
+    }
+}
+
+
+static u_char *ngx_strlascii_sse2(u_char *p, u_char *last)
+{
+    int  mask;
+
+    for (/* void */; last - p >= 16; p += 16) {
+        mask = _mm_movemask_epi8(_mm_loadu_si128((__m128i *) p));
+
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+
+    return ngx_strlascii_scalar(p, last);
+}
+
+#endif
+
+
+#if (NGX_HAVE_AVX2)
+
+/*
+ * the upper halves of the ymm registers are zeroed before the SSE2 code
+ * to avoid the penalty of the transition between the AVX and SSE states
+ */
+
+#define ngx_lower_avx2(v)                                                     \
+    _mm256_or_si256(v, _mm256_and_si256(_mm256_set1_epi8(0x20),               \
+        _mm256_andnot_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('Z')),      \
+                            _mm256_cmpgt_epi8(v, _mm256_set1_epi8('A' - 1)))))
+
+
+static void ngx_strlow_avx2(u_char *dst, u_char *src, size_t n)
+{
+    __m256i  v;
+
+    for (/* void */; n >= 32; n -= 32, src += 32, dst += 32) {
+        v = _mm256_loadu_si256((__m256i *) src);
+        _mm256_storeu_si256((__m256i *) dst, ngx_lower_avx2(v));
+    }
+
+    _mm256_zeroupper();
+
+    ngx_strlow_sse2(dst, src, n);
+}
+
+
+static ngx_int_t ngx_memcasecmp_avx2(u_char *s1, u_char *s2, size_t n)
+{
+    __m256i  v1, v2;
+
+    for (/* void */; n >= 32; n -= 32, s1 += 32, s2 += 32) {
+        v1 = _mm256_loadu_si256((__m256i *) s1);
+        v2 = _mm256_loadu_si256((__m256i *) s2);
+
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(ngx_lower_avx2(v1),
+                                                   ngx_lower_avx2(v2)))
+            != -1)
+        {
+            _mm256_zeroupper();
+            return ngx_memcasecmp_sse2(s1, s2, 32);
+        }
+    }
+
+    _mm256_zeroupper();
+
+    return ngx_memcasecmp_sse2(s1, s2, n);
+}
+
+
+static u_char *ngx_strlchr_avx2(u_char *p, u_char *last, u_char c)
+{
+    int      mask;
+    __m256i  v, s;
+
+    s = _mm256_set1_epi8(c);
+
+    for (/* void */; last - p >= 32; p += 32) {
+        v = _mm256_loadu_si256((__m256i *) p);
+
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, s));
+
+        if (mask) {
+            _mm256_zeroupper();
+            return p + __builtin_ctz(mask);
+        }
+    }
+
+    _mm256_zeroupper();
+
+    return ngx_strlchr_sse2(p, last, c);
+}
+
+
+static u_char *ngx_strlascii_avx2(u_char *p, u_char *last)
+{
+    int  mask;
+
+    for (/* void */; last - p >= 32; p += 32) {
+        mask = _mm256_movemask_epi8(_mm256_loadu_si256((__m256i *) p));
+
+        if (mask) {
+            _mm256_zeroupper();
+            return p + __builtin_ctz(mask);
+        }
+    }
+
+    _mm256_zeroupper();
+
+    return ngx_strlascii_sse2(p, last);
+}
+
+#endif
+
+
+/*
+ * the digits are written from the end two at a time, the number of
+ * the digits is found by the comparisons with the powers of 10
+ */
+
+static u_char  ngx_dec_pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static u_char  ngx_hex_digits[] = "0123456789abcdef";
+
+
+u_char *ngx_sprint_uint(u_char *buf, uint64_t n)
+{
+    u_char      *p;
+    size_t       len;
+    uint64_t     m;
+    ngx_uint_t   i;
+
+    for (len = 1, m = 10; len < 20 && n >= m; len++, m *= 10) {
+        /* void */
+    }
+
+    p = buf + len;
+
+    while (n >= 100) {
+        i = (ngx_uint_t) (n % 100) * 2;
+        n /= 100;
+
+        *--p = ngx_dec_pairs[i + 1];
+        *--p = ngx_dec_pairs[i];
+    }
+
+    if (n >= 10) {
+        i = (ngx_uint_t) n * 2;
+
+        *--p = ngx_dec_pairs[i + 1];
+        *--p = ngx_dec_pairs[i];
+
+    } else {
+        *--p = (u_char) ('0' + n);
+    }
+
+    return buf + len;
+}
+
+
+u_char *ngx_sprint_int(u_char *buf, int64_t n)
+{
+    if (n < 0) {
+        *buf++ = '-';
+        return ngx_sprint_uint(buf, - (uint64_t) n);
+    }
+
+    return ngx_sprint_uint(buf, (uint64_t) n);
+}
+
+
+u_char *ngx_sprint_hex(u_char *buf, uint64_t n)
+{
+    u_char    *p;
+    size_t     len;
+    uint64_t   m;
+
+    for (len = 1, m = n >> 4; m; len++, m >>= 4) {
+        /* void */
+    }
+
+    p = buf + len;
+
+    do {
+        *--p = ngx_hex_digits[n & 0xf];
+        n >>= 4;
+    } while (n);
+
+    return buf + len;
+}
+
+
 ngx_int_t ngx_atoi(u_char *line, size_t n)
 {
     ngx_int_t  value;
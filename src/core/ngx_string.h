@@ -46,6 +46,9 @@ typedef struct {
 #endif
 
 
+#define ngx_tolower(c)      (u_char) ((c >= 'A' && c <= 'Z') ? (c | 0x20) : c)
+
+
 #define ngx_strncmp(s1, s2, n)                                               \
                             strncmp((const char *) s1, (const char *) s2, n)
 
@@ -72,6 +75,48 @@ typedef struct {
 u_char *ngx_cpystrn(u_char *dst, u_char *src, size_t n);
 ngx_int_t ngx_rstrncmp(u_char *s1, u_char *s2, size_t n);
 
+
+/*
+ * the string primitives that have the SSE2 and AVX2 versions,
+ * ngx_string_init() sets the best ones that the CPU supports
+ */
+
+typedef struct {
+    void        (*strlow)(u_char *dst, u_char *src, size_t n);
+    ngx_int_t   (*memcasecmp)(u_char *s1, u_char *s2, size_t n);
+    u_char     *(*strlchr)(u_char *p, u_char *last, u_char c);
+    u_char     *(*strlascii)(u_char *p, u_char *last);
+} ngx_string_ops_t;
+
+extern ngx_string_ops_t  ngx_string_ops;
+
+#define NGX_STRING_SCALAR  0
+#define NGX_STRING_SSE2    1
+#define NGX_STRING_AVX2    2
+
+ngx_uint_t ngx_string_init(ngx_uint_t simd);
+
+/* copies n bytes in lowercase */
+#define ngx_strlow          ngx_string_ops.strlow
+
+/* compares n bytes case-insensitively, does not stop at '\0' */
+#define ngx_memcasecmp      ngx_string_ops.memcasecmp
+
+/* finds the first c in [p, last) or returns NULL */
+#define ngx_strlchr         ngx_string_ops.strlchr
+
+/* skips the ASCII bytes, returns the first byte above 0x7f or last */
+#define ngx_strlascii       ngx_string_ops.strlascii
+
+/*
+ * the decimal and hexadecimal formatters for the hot paths, they return
+ * the end of the written digits and do not write '\0'
+ */
+
+u_char *ngx_sprint_uint(u_char *buf, uint64_t n);
+u_char *ngx_sprint_int(u_char *buf, int64_t n);
+u_char *ngx_sprint_hex(u_char *buf, uint64_t n);
+
 ngx_int_t ngx_atoi(u_char *line, size_t n);
 ngx_int_t ngx_hextoi(u_char *line, size_t n);
 
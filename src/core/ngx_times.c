@@ -22,8 +22,16 @@ static ngx_int_t  ngx_gmtoff;
  * time value and strings.  Thus thread may get the corrupted values only
  * if it is preempted while copying and then it is not scheduled to run
  * more than NGX_TIME_SLOTS seconds.
+ *
+ * The seconds and milliseconds are updated on every event cycle and
+ * are protected by the sequence number: it is odd while the update is
+ * in progress, so ngx_time_get() repeats the copying until it gets
+ * the same even number before and after the copying.
  */
 
+static ngx_atomic_t           ngx_time_seq;
+static volatile ngx_time_t    ngx_cached_tp;
+
 #if (NGX_THREADS)
 
 #define NGX_TIME_SLOTS  60
@@ -95,14 +103,14 @@ void ngx_time_init()
     ngx_gettimeofday(&tv);
 
     ngx_start_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000 + tv.tv_usec / 1000;
-    ngx_old_elapsed_msec = 0;
-    ngx_elapsed_msec = 0;
 
 #if !(WIN32)
     tzset();
 #endif
 
-    ngx_time_update(tv.tv_sec);
+    ngx_time_update();
+
+    ngx_old_elapsed_msec = ngx_elapsed_msec;
 }
 
 
@@ -120,21 +128,54 @@ ngx_int_t ngx_time_mutex_init(ngx_log_t *log)
 #endif
 
 
-void ngx_time_update(time_t s)
+/*
+ * 每个事件循环调用一次：更新毫秒级的缓存时间和 ngx_elapsed_msec，
+ * 格式化的时间字符串每秒只更新一次
+ */
+
+void ngx_time_update()
 {
-    u_char    *p;
-    ngx_tm_t   tm;
+    u_char          *p;
+    time_t           s;
+    ngx_uint_t       msec;
+    ngx_tm_t         tm;
+    struct timeval   tv;
 
-    if (ngx_time() == s) { // 还是当前这秒
+    ngx_gettimeofday(&tv);
+
+    s = tv.tv_sec;
+    msec = tv.tv_usec / 1000;
+
+    ngx_elapsed_msec = (ngx_epoch_msec_t) s * 1000 + msec - ngx_start_msec;
+
+#if (NGX_THREADS)
+
+    if (ngx_mutex_trylock(ngx_time_mutex) != NGX_OK) {
         return;
     }
 
+#endif
+
+    ngx_time_seq++;
+    ngx_memory_barrier();
+
+    ngx_cached_tp.sec = s;
+    ngx_cached_tp.msec = msec;
+
+    ngx_memory_barrier();
+    ngx_time_seq++;
+
+    if (ngx_time() == s) { // 还是当前这秒
+
 #if (NGX_THREADS)
+        ngx_mutex_unlock(ngx_time_mutex);
+#endif
 
-    if (ngx_mutex_trylock(ngx_time_mutex) != NGX_OK) {
         return;
     }
 
+#if (NGX_THREADS)
+
     if (slot == NGX_TIME_SLOTS) {
         slot = 0;
     } else {
@@ -216,6 +257,23 @@ void ngx_time_update(time_t s)
 }
 
 
+void ngx_time_get(ngx_time_t *tp)
+{
+    ngx_atomic_t  seq;
+
+    do {
+        seq = ngx_time_seq;
+        ngx_memory_barrier();
+
+        tp->sec = ngx_cached_tp.sec;
+        tp->msec = ngx_cached_tp.msec;
+
+        ngx_memory_barrier();
+
+    } while ((seq & 1) || seq != ngx_time_seq);
+}
+
+
 size_t ngx_http_time(u_char *buf, time_t t)
 {
     ngx_tm_t  tm;
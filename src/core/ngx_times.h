@@ -16,8 +16,15 @@
 #include <ngx_core.h>
 
 
+typedef struct {
+    time_t      sec;
+    ngx_uint_t  msec;
+} ngx_time_t;
+
+
 void ngx_time_init();
-void ngx_time_update(time_t s);
+void ngx_time_update();
+void ngx_time_get(ngx_time_t *tp);
 size_t ngx_http_time(u_char *buf, time_t t);
 size_t ngx_http_cookie_time(u_char *buf, time_t t);
 void ngx_gmtime(time_t t, ngx_tm_t *tp);
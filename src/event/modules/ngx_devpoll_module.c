@@ -326,7 +326,6 @@ int ngx_devpoll_process_events(ngx_cycle_t *cycle)
     ngx_connection_t   *c;
     ngx_epoch_msec_t    delta;
     struct dvpoll       dvp;
-    struct timeval      tv;
 
     for ( ;; ) {
         timer = ngx_event_find_timer();
@@ -401,12 +400,8 @@ int ngx_devpoll_process_events(ngx_cycle_t *cycle)
 
     nchanges = 0;
 
-    ngx_gettimeofday(&tv);
-    ngx_time_update(tv.tv_sec);
-
-    delta = ngx_elapsed_msec;
-    ngx_elapsed_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000
-                                          + tv.tv_usec / 1000 - ngx_start_msec;
+    delta = ngx_old_elapsed_msec;
+    ngx_time_update();
 
     if (err) {
         ngx_log_error((err == NGX_EINTR) ? NGX_LOG_INFO : NGX_LOG_ALERT,
@@ -414,7 +414,6 @@ int ngx_epoll_process_events(ngx_cycle_t *cycle)
     ngx_log_t         *log;
     ngx_msec_t         timer;
     ngx_event_t       *rev, *wev;
-    struct timeval     tv;
     ngx_connection_t  *c;
     ngx_epoch_msec_t   delta;
 
@@ -506,12 +505,8 @@ int ngx_epoll_process_events(ngx_cycle_t *cycle)
         err = 0;
     }
 
-    ngx_gettimeofday(&tv);
-    ngx_time_update(tv.tv_sec);
-
-    delta = ngx_elapsed_msec;
-    ngx_elapsed_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000
-                                          + tv.tv_usec / 1000 - ngx_start_msec;
+    delta = ngx_old_elapsed_msec;
+    ngx_time_update();
 
     if (timer != NGX_TIMER_INFINITE) {
         delta = ngx_elapsed_msec - delta; // 更新后的运行时间与上一次的差值
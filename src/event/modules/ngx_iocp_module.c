@@ -169,7 +169,6 @@ static ngx_int_t ngx_iocp_process_events(ngx_cycle_t *cycle)
     ngx_err_t          err;
     ngx_msec_t         timer;
     ngx_event_t       *ev;
-    struct timeval     tv;
     ngx_epoch_msec_t   delta;
     ngx_event_ovlp_t  *ovlp;
 
@@ -191,15 +190,11 @@ static ngx_int_t ngx_iocp_process_events(ngx_cycle_t *cycle)
         err = 0;
     }
 
-    ngx_gettimeofday(&tv);
-    ngx_time_update(tv.tv_sec);
-
     ngx_log_debug4(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
                    "iocp: %d b:%d k:%d ov:" PTR_FMT, rc, bytes, key, ovlp);
 
-    delta = ngx_elapsed_msec;
-    ngx_elapsed_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000
-                                          + tv.tv_usec / 1000 - ngx_start_msec;
+    delta = ngx_old_elapsed_msec;
+    ngx_time_update();
 
     if (err) {
         if (ovlp == NULL) {
@@ -424,7 +424,6 @@ static ngx_int_t ngx_kqueue_process_events(ngx_cycle_t *cycle)
     ngx_msec_t         timer;
     ngx_event_t       *ev;
     ngx_epoch_msec_t   delta;
-    struct timeval     tv;
     struct timespec    ts, *tp;
 
     for ( ;; ) {
@@ -517,15 +516,11 @@ static ngx_int_t ngx_kqueue_process_events(ngx_cycle_t *cycle)
         err = 0;
     }
 
-    ngx_gettimeofday(&tv);
-    ngx_time_update(tv.tv_sec);
-
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
                    "kevent events: %d", events);
 
-    delta = ngx_elapsed_msec;
-    ngx_elapsed_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000
-                                          + tv.tv_usec / 1000 - ngx_start_msec;
+    delta = ngx_old_elapsed_msec;
+    ngx_time_update();
 
     if (err) {
         ngx_log_error((err == NGX_EINTR) ? NGX_LOG_INFO : NGX_LOG_ALERT,
@@ -271,7 +271,6 @@ static ngx_int_t ngx_poll_process_events(ngx_cycle_t *cycle)
     ngx_event_t        *ev;
     ngx_epoch_msec_t    delta;
     ngx_connection_t   *c;
-    struct timeval      tv;
 
     for ( ;; ) {
         timer = ngx_event_find_timer();
@@ -337,12 +336,8 @@ static ngx_int_t ngx_poll_process_events(ngx_cycle_t *cycle)
         err = 0;
     }
 
-    ngx_gettimeofday(&tv);
-    ngx_time_update(tv.tv_sec);
-
-    delta = ngx_elapsed_msec;
-    ngx_elapsed_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000
-                                          + tv.tv_usec / 1000 - ngx_start_msec;
+    delta = ngx_old_elapsed_msec;
+    ngx_time_update();
 
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
                    "poll ready %d of %d", ready, nevents);
@@ -278,7 +278,6 @@ ngx_int_t ngx_rtsig_process_events(ngx_cycle_t *cycle)
     ngx_err_t           err;
     siginfo_t           si;
     ngx_event_t        *rev, *wev;
-    struct timeval      tv;
     struct timespec     ts, *tp;
     struct sigaction    sa;
     ngx_epoch_msec_t    delta;
@@ -389,12 +388,8 @@ ngx_int_t ngx_rtsig_process_events(ngx_cycle_t *cycle)
                        signo, si.si_fd, si.si_band);
     }
 
-    ngx_gettimeofday(&tv);
-    ngx_time_update(tv.tv_sec);
-
-    delta = ngx_elapsed_msec;
-    ngx_elapsed_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000
-                                          + tv.tv_usec / 1000 - ngx_start_msec;
+    delta = ngx_old_elapsed_msec;
+    ngx_time_update();
 
     if (err) {
         ngx_accept_mutex_unlock();
@@ -374,12 +374,8 @@ static ngx_int_t ngx_select_process_events(ngx_cycle_t *cycle)
 
         deltas += delta;
         if (deltas > 1000) {
-            ngx_gettimeofday(&tv);
-            ngx_time_update(tv.tv_sec);
-            deltas = tv.tv_usec / 1000;
-
-            ngx_elapsed_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000
-                                          + tv.tv_usec / 1000 - ngx_start_msec;
+            ngx_time_update();
+            deltas = (ngx_start_msec + ngx_elapsed_msec) % 1000;
         } else {
             ngx_elapsed_msec += delta;
         }
@@ -389,11 +385,7 @@ static ngx_int_t ngx_select_process_events(ngx_cycle_t *cycle)
 
     } else {
         delta = 0;
-        ngx_gettimeofday(&tv);
-        ngx_time_update(tv.tv_sec);
-
-        ngx_elapsed_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000
-                                          + tv.tv_usec / 1000 - ngx_start_msec;
+        ngx_time_update();
 
         if (ready == 0) {
             ngx_log_error(NGX_LOG_ALERT, cycle->log, 0,
@@ -405,12 +397,8 @@ static ngx_int_t ngx_select_process_events(ngx_cycle_t *cycle)
 
 #else /* !(HAVE_SELECT_CHANGE_TIMEOUT) */
 
-    ngx_gettimeofday(&tv);
-    ngx_time_update(tv.tv_sec);
-
-    delta = ngx_elapsed_msec;
-    ngx_elapsed_msec = (ngx_epoch_msec_t) tv.tv_sec * 1000
-                                          + tv.tv_usec / 1000 - ngx_start_msec;
+    delta = ngx_old_elapsed_msec;
+    ngx_time_update();
 
     if (timer != NGX_TIMER_INFINITE) {
         delta = ngx_elapsed_msec - delta;
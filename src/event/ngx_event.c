@@ -70,6 +70,13 @@ ngx_uint_t                        ngx_accept_mutex_held;
 ngx_msec_t                        ngx_accept_mutex_delay;
 // 禁止接收连接全局标志。如果大于0表示压力过大，不再接收新请求
 ngx_int_t                         ngx_accept_disabled;
+// 上一秒内最长的一次事件处理的毫秒数，即事件循环的延迟
+ngx_msec_t                        ngx_event_lag;
+// 是否计算 ngx_event_lag，由使用它的 "gzip_adaptive" 设置
+ngx_uint_t                        ngx_event_lag_enabled;
+
+static ngx_msec_t                 ngx_event_lag_max;
+static time_t                     ngx_event_lag_sec;
 
 
 #if (NGX_STAT_STUB)
@@ -161,6 +168,20 @@ static ngx_command_t  ngx_event_core_commands[] = {
       offsetof(ngx_event_conf_t, accept_mutex_delay),
       NULL },
 
+    { ngx_string("timer_wheel"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_flag_slot,
+      0,
+      offsetof(ngx_event_conf_t, timer_wheel),
+      NULL },
+
+    { ngx_string("timer_lazy"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      0,
+      offsetof(ngx_event_conf_t, timer_lazy),
+      NULL },
+
     { ngx_string("debug_connection"),
       NGX_EVENT_CONF|NGX_CONF_TAKE1,
       ngx_event_debug_connection,
@@ -282,6 +303,9 @@ static ngx_int_t ngx_event_process_init(ngx_cycle_t *cycle)
     }
 #endif
 
+    ngx_event_timer_wheel = ecf->timer_wheel;
+    ngx_event_timer_lazy = ecf->timer_lazy / NGX_TIMER_RESOLUTION;
+
     if (ngx_event_timer_init(cycle->log) == NGX_ERROR) {
         return NGX_ERROR;
     }
@@ -681,6 +705,8 @@ static void *ngx_event_create_conf(ngx_cycle_t *cycle)
     ecf->multi_accept = NGX_CONF_UNSET;
     ecf->accept_mutex = NGX_CONF_UNSET;
     ecf->accept_mutex_delay = NGX_CONF_UNSET_MSEC;
+    ecf->timer_wheel = NGX_CONF_UNSET;
+    ecf->timer_lazy = NGX_CONF_UNSET_MSEC;
     ecf->name = (void *) NGX_CONF_UNSET;
 
 #if (NGX_DEBUG)
@@ -773,6 +799,8 @@ static char *ngx_event_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_conf_init_value(ecf->multi_accept, 0);
     ngx_conf_init_value(ecf->accept_mutex, 1);
     ngx_conf_init_msec_value(ecf->accept_mutex_delay, 500);
+    ngx_conf_init_value(ecf->timer_wheel, 0);
+    ngx_conf_init_msec_value(ecf->timer_lazy, 0);
 
 #if (HAVE_RTSIG)
     if (ecf->use == ngx_rtsig_module.ctx_index && ecf->accept_mutex == 0) {
@@ -806,3 +834,35 @@ static char *ngx_accept_mutex_check(ngx_conf_t *cf, void *post, void *data)
 
     return NGX_CONF_OK;
 }
+
+
+/*
+ * 在每次 ngx_process_events() 之后调用：ngx_elapsed_msec 是事件返回时
+ * 的时间，与当前时间的差就是这一轮处理事件所用的时间，
+ * 每秒把其中的最大值保存到 ngx_event_lag
+ */
+
+void ngx_event_update_lag()
+{
+    ngx_msec_t        busy;
+    struct timeval    tv;
+    ngx_epoch_msec_t  now;
+
+    ngx_gettimeofday(&tv);
+
+    now = (ngx_epoch_msec_t) tv.tv_sec * 1000 + tv.tv_usec / 1000
+                                                            - ngx_start_msec;
+
+    busy = (now > ngx_elapsed_msec) ? (ngx_msec_t) (now - ngx_elapsed_msec)
+                                    : 0;
+
+    if (busy > ngx_event_lag_max) {
+        ngx_event_lag_max = busy;
+    }
+
+    if (ngx_event_lag_sec != tv.tv_sec) {
+        ngx_event_lag_sec = tv.tv_sec;
+        ngx_event_lag = ngx_event_lag_max;
+        ngx_event_lag_max = 0;
+    }
+}
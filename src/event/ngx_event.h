@@ -167,6 +167,10 @@ struct ngx_event_s {
     void            *rbtree_parent;
     char             rbtree_color;
 
+    // timer_key 是定时器要求的超时时间，延迟重设时大于 rbtree_key，
+    // 定时器到期时如果还没到 timer_key 就按 timer_key 重新加入
+    ngx_int_t        timer_key;
+
 
     unsigned         closed:1;
 
@@ -437,6 +441,9 @@ typedef struct {
 
     ngx_msec_t    accept_mutex_delay;
 
+    ngx_flag_t    timer_wheel;
+    ngx_msec_t    timer_lazy;
+
     u_char       *name;
 
 #if (NGX_DEBUG)
@@ -463,6 +470,8 @@ extern ngx_atomic_t          *ngx_accept_mutex;
 extern ngx_uint_t             ngx_accept_mutex_held;
 extern ngx_msec_t             ngx_accept_mutex_delay;
 extern ngx_int_t              ngx_accept_disabled;
+extern ngx_msec_t             ngx_event_lag;
+extern ngx_uint_t             ngx_event_lag_enabled;
 
 
 #if (NGX_STAT_STUB)
@@ -497,6 +506,7 @@ void ngx_event_accept(ngx_event_t *ev);
 ngx_int_t ngx_trylock_accept_mutex(ngx_cycle_t *cycle);
 ngx_int_t ngx_disable_accept_events(ngx_cycle_t *cycle);
 ngx_int_t ngx_enable_accept_events(ngx_cycle_t *cycle);
+void ngx_event_update_lag();
 
 
 #if (WIN32)
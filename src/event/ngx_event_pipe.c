@@ -291,7 +291,12 @@ ngx_int_t ngx_event_pipe_read_upstream(ngx_event_pipe_t *p)
                 }
 
                 n -= size;
+
+                /* the filled buf is shadowed now, so its link is not needed */
+
+                tl = cl;
                 cl = cl->next;
+                ngx_free_chain(tl);
 
             } else {
                 cl->buf->last += n;
@@ -339,7 +344,9 @@ ngx_int_t ngx_event_pipe_read_upstream(ngx_event_pipe_t *p)
             return NGX_ABORT;
         }
 
-        p->free_raw_bufs = p->free_raw_bufs->next;
+        cl = p->free_raw_bufs;
+        p->free_raw_bufs = cl->next;
+        ngx_free_chain(cl);
 
         if (p->free_bufs) {
             for (cl = p->free_raw_bufs; cl; cl = cl->next) {
@@ -626,8 +633,10 @@ ngx_int_t ngx_event_pipe_copy_input_filter(ngx_event_pipe_t *p, ngx_buf_t *buf)
     }
 
     if (p->free) {
-        b = p->free->buf;
-        p->free = p->free->next;
+        cl = p->free;
+        b = cl->buf;
+        p->free = cl->next;
+        ngx_free_chain(cl);
 
     } else {
         if (!(b = ngx_alloc_buf(p->pool))) {
@@ -703,6 +712,7 @@ ngx_inline static void ngx_event_pipe_free_shadow_raw_buf(ngx_chain_t **free,
     for (cl = *free ; cl; cl = cl->next) {
         if (cl->buf == s) {
             *ll = cl->next;
+            ngx_free_chain(cl);
             break;
         }
 
@@ -20,6 +20,42 @@ ngx_thread_volatile ngx_rbtree_t  *ngx_event_timer_rbtree;
 ngx_rbtree_t                       ngx_event_timer_sentinel;
 
 
+/*
+ * the hierarchical timing wheel: the first level has the slot for every
+ * key of the nearest 256 keys, each slot of the next three levels has
+ * the keys of 256, 16K and 1M following keys.  The timers of the next
+ * level slot are moved down when the lower level wraps around, so
+ * the adding and the deleting are O(1) and the expired timers are taken
+ * from the first level slot of the current key.
+ *
+ * The events in a slot are linked through ev->rbtree_right, and
+ * ev->rbtree_left points to the previous link.
+ */
+
+#define NGX_TIMER_WHEEL_SLOTS0  256
+#define NGX_TIMER_WHEEL_SLOTS   64
+#define NGX_TIMER_WHEEL_LEVELS  4
+#define NGX_TIMER_WHEEL_MAX     (1 << (8 + 3 * 6))
+
+static void **ngx_event_timer_wheel_slot(ngx_int_t key);
+static void ngx_event_timer_wheel_cascade(ngx_uint_t level);
+static ngx_msec_t ngx_event_timer_wheel_find(void);
+static void ngx_event_timer_wheel_expire(ngx_int_t key);
+
+ngx_uint_t         ngx_event_timer_wheel;
+
+ngx_int_t          ngx_event_timer_lazy;
+ngx_uint_t         ngx_event_timer_lazy_n;
+ngx_uint_t         ngx_event_timer_early_n;
+
+static void       *ngx_event_timer_slots[NGX_TIMER_WHEEL_SLOTS0
+                            + (NGX_TIMER_WHEEL_LEVELS - 1)
+                                                      * NGX_TIMER_WHEEL_SLOTS];
+// 时间轮中下一个要处理的 key，之前的都已经过期了
+static ngx_int_t   ngx_event_timer_now;
+static ngx_uint_t  ngx_event_timers;
+
+
 ngx_int_t ngx_event_timer_init(ngx_log_t *log)
 {
     if (ngx_event_timer_rbtree) {
@@ -31,6 +67,8 @@ ngx_int_t ngx_event_timer_init(ngx_log_t *log)
 
     ngx_event_timer_rbtree = &ngx_event_timer_sentinel;
 
+    ngx_event_timer_now = ngx_elapsed_msec / NGX_TIMER_RESOLUTION;
+
 #if (NGX_THREADS)
     if (!(ngx_event_timer_mutex = ngx_mutex_init(log, 0))) {
         return NGX_ERROR;
@@ -46,6 +84,10 @@ ngx_msec_t ngx_event_find_timer(void)
     ngx_msec_t     timer;
     ngx_rbtree_t  *node;
 
+    if (ngx_event_timer_wheel) {
+        return ngx_event_timer_wheel_find();
+    }
+
     if (ngx_event_timer_rbtree == &ngx_event_timer_sentinel) {
         return NGX_TIMER_INFINITE;
     }
@@ -80,6 +122,12 @@ void ngx_event_expire_timers(ngx_msec_t timer)
         timer = 0;
     }
 
+    if (ngx_event_timer_wheel) {
+        ngx_event_timer_wheel_expire((ngx_int_t)
+                         (ngx_old_elapsed_msec + timer) / NGX_TIMER_RESOLUTION);
+        return;
+    }
+
     for ( ;; ) { // 遍历获取红黑树的最小节点
 
         if (ngx_event_timer_rbtree == &ngx_event_timer_sentinel) {
@@ -126,6 +174,30 @@ void ngx_event_expire_timers(ngx_msec_t timer)
                               &ngx_event_timer_sentinel,
                               (ngx_rbtree_t *) &ev->rbtree_key);
 
+            /* the lazily re-armed timer is added again with the new key */
+
+            if (ev->timer_key > (ngx_int_t)
+                         (ngx_old_elapsed_msec + timer) / NGX_TIMER_RESOLUTION)
+            {
+                ev->rbtree_key = ev->timer_key;
+
+                ngx_rbtree_insert((ngx_rbtree_t **) &ngx_event_timer_rbtree,
+                                  &ngx_event_timer_sentinel,
+                                  (ngx_rbtree_t *) &ev->rbtree_key);
+
+                ngx_event_timer_early_n++;
+
+                ngx_mutex_unlock(ngx_event_timer_mutex);
+
+#if (NGX_THREADS)
+                if (ngx_threaded) {
+                    ngx_unlock(ev->lock);
+                }
+#endif
+
+                continue;
+            }
+
             ngx_mutex_unlock(ngx_event_timer_mutex);
 
 #if (NGX_DEBUG)
@@ -166,3 +238,252 @@ void ngx_event_expire_timers(ngx_msec_t timer)
 
     ngx_mutex_unlock(ngx_event_timer_mutex);
 }
+
+
+void ngx_event_timer_wheel_add(ngx_event_t *ev)
+{
+    void  **slot;
+
+    slot = ngx_event_timer_wheel_slot(ev->rbtree_key);
+
+    ev->rbtree_right = *slot;
+
+    if (*slot) {
+        ((ngx_event_t *) *slot)->rbtree_left = &ev->rbtree_right;
+    }
+
+    ev->rbtree_left = slot;
+    *slot = ev;
+
+    ngx_event_timers++;
+}
+
+
+void ngx_event_timer_wheel_del(ngx_event_t *ev)
+{
+    void  **prev;
+
+    prev = ev->rbtree_left;
+    *prev = ev->rbtree_right;
+
+    if (ev->rbtree_right) {
+        ((ngx_event_t *) ev->rbtree_right)->rbtree_left = prev;
+    }
+
+    ngx_event_timers--;
+}
+
+
+static void **ngx_event_timer_wheel_slot(ngx_int_t key)
+{
+    ngx_int_t  delta;
+
+    delta = key - ngx_event_timer_now;
+
+    if (delta < 0) {
+        /* the timer has already expired, it is taken with the current key */
+        key = ngx_event_timer_now;
+        delta = 0;
+    }
+
+    if (delta < NGX_TIMER_WHEEL_SLOTS0) {
+        return &ngx_event_timer_slots[key & 0xff];
+    }
+
+    if (delta < (1 << 14)) {
+        return &ngx_event_timer_slots[NGX_TIMER_WHEEL_SLOTS0
+                                      + ((key >> 8) & 0x3f)];
+    }
+
+    if (delta < (1 << 20)) {
+        return &ngx_event_timer_slots[NGX_TIMER_WHEEL_SLOTS0
+                                      + NGX_TIMER_WHEEL_SLOTS
+                                      + ((key >> 14) & 0x3f)];
+    }
+
+    if (delta >= NGX_TIMER_WHEEL_MAX) {
+        /* the far timer is placed again when its slot is moved down */
+        key = ngx_event_timer_now + NGX_TIMER_WHEEL_MAX - 1;
+    }
+
+    return &ngx_event_timer_slots[NGX_TIMER_WHEEL_SLOTS0
+                                  + 2 * NGX_TIMER_WHEEL_SLOTS
+                                  + ((key >> 20) & 0x3f)];
+}
+
+
+/* the level slot of the current key is moved down to the lower levels */
+
+static void ngx_event_timer_wheel_cascade(ngx_uint_t level)
+{
+    void         **slot;
+    ngx_event_t   *ev, *next;
+
+    slot = &ngx_event_timer_slots[NGX_TIMER_WHEEL_SLOTS0
+                                  + (level - 1) * NGX_TIMER_WHEEL_SLOTS
+                                  + ((ngx_event_timer_now >> (2 + 6 * level))
+                                                                      & 0x3f)];
+
+    next = *slot;
+    *slot = NULL;
+
+    while (next) {
+        ev = next;
+        next = ev->rbtree_right;
+
+        ngx_event_timers--;
+
+        ngx_event_timer_wheel_add(ev);
+    }
+}
+
+
+static ngx_msec_t ngx_event_timer_wheel_find(void)
+{
+    ngx_int_t   key;
+    ngx_msec_t  timer;
+
+    if (ngx_event_timers == 0) {
+        return NGX_TIMER_INFINITE;
+    }
+
+    if (ngx_mutex_lock(ngx_event_timer_mutex) == NGX_ERROR) {
+        return NGX_TIMER_ERROR;
+    }
+
+    /*
+     * the first level slots are tested up to the wrap around,
+     * where the timers of the next levels may be moved down
+     */
+
+    for (key = ngx_event_timer_now; key & 0xff; key++) {
+        if (ngx_event_timer_slots[key & 0xff]) {
+            break;
+        }
+    }
+
+    ngx_mutex_unlock(ngx_event_timer_mutex);
+
+    timer = (ngx_msec_t)
+         (key * NGX_TIMER_RESOLUTION -
+               ngx_elapsed_msec / NGX_TIMER_RESOLUTION * NGX_TIMER_RESOLUTION);
+
+    return timer > 0 ? timer: 0 ;
+}
+
+
+static void ngx_event_timer_wheel_expire(ngx_int_t key)
+{
+    void         **slot;
+    ngx_uint_t     level;
+    ngx_event_t   *ev;
+
+    if (ngx_mutex_lock(ngx_event_timer_mutex) == NGX_ERROR) {
+        return;
+    }
+
+    while (ngx_event_timer_now <= key) {
+
+        if (ngx_event_timers == 0) {
+            ngx_event_timer_now = key + 1;
+            break;
+        }
+
+        if ((ngx_event_timer_now & 0xff) == 0) {
+            for (level = 1; level < NGX_TIMER_WHEEL_LEVELS; level++) {
+                ngx_event_timer_wheel_cascade(level);
+
+                if ((ngx_event_timer_now >> (2 + 6 * level)) & 0x3f) {
+                    break;
+                }
+            }
+        }
+
+        /* all timers of the first level slot of the current key expire */
+
+        slot = &ngx_event_timer_slots[ngx_event_timer_now & 0xff];
+
+        while (*slot) {
+            ev = *slot;
+
+#if (NGX_THREADS)
+
+            if (ngx_threaded && ngx_trylock(ev->lock) == 0) {
+
+                /* the rest of the slot is expired on the next call */
+
+                ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                               "event " PTR_FMT " is busy in expire timers",
+                               ev);
+
+                ngx_mutex_unlock(ngx_event_timer_mutex);
+                return;
+            }
+#endif
+
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                           "event timer del: %d: %d",
+                            ngx_event_ident(ev->data), ev->rbtree_key);
+
+            ngx_event_timer_wheel_del(ev);
+
+            /* the lazily re-armed timer is added again with the new key */
+
+            if (ev->timer_key > key) {
+                ev->rbtree_key = ev->timer_key;
+
+                ngx_event_timer_wheel_add(ev);
+
+                ngx_event_timer_early_n++;
+
+#if (NGX_THREADS)
+                if (ngx_threaded) {
+                    ngx_unlock(ev->lock);
+                }
+#endif
+
+                continue;
+            }
+
+            ngx_mutex_unlock(ngx_event_timer_mutex);
+
+#if (NGX_DEBUG)
+            ev->rbtree_left = NULL;
+            ev->rbtree_right = NULL;
+            ev->rbtree_parent = NULL;
+#endif
+
+            ev->timer_set = 0;
+
+#if (NGX_THREADS)
+            if (ngx_threaded) {
+                if (ngx_mutex_lock(ngx_posted_events_mutex) == NGX_ERROR) {
+                    return;
+                }
+
+                ev->posted_timedout = 1;
+                ngx_post_event(ev);
+
+                ngx_mutex_unlock(ngx_posted_events_mutex);
+
+                ngx_unlock(ev->lock);
+
+            } else {
+                ev->timedout = 1;
+                ev->event_handler(ev);
+            }
+#else
+            ev->timedout = 1;
+            ev->event_handler(ev);
+#endif
+
+            if (ngx_mutex_lock(ngx_event_timer_mutex) == NGX_ERROR) {
+                return;
+            }
+        }
+
+        ngx_event_timer_now++;
+    }
+
+    ngx_mutex_unlock(ngx_event_timer_mutex);
+}
@@ -43,6 +43,24 @@ extern ngx_mutex_t  *ngx_event_timer_mutex;
 extern ngx_thread_volatile ngx_rbtree_t  *ngx_event_timer_rbtree;
 extern ngx_rbtree_t                       ngx_event_timer_sentinel;
 
+/*
+ * ngx_event_timer_wheel 为 1 时定时器保存在时间轮中而不是红黑树中，
+ * 由 events 块的 timer_wheel 指令设置
+ */
+extern ngx_uint_t                         ngx_event_timer_wheel;
+
+/*
+ * ngx_event_timer_lazy 是延迟重设的窗口，由 timer_lazy 指令设置，
+ * 在窗口内推后的定时器只记录新的超时时间，不操作红黑树或时间轮；
+ * 计数器是每个进程的：延迟重设的次数和到期时重新加入的次数
+ */
+extern ngx_int_t                          ngx_event_timer_lazy;
+extern ngx_uint_t                         ngx_event_timer_lazy_n;
+extern ngx_uint_t                         ngx_event_timer_early_n;
+
+void ngx_event_timer_wheel_add(ngx_event_t *ev);
+void ngx_event_timer_wheel_del(ngx_event_t *ev);
+
 
 // 删除时间事件
 ngx_inline static void ngx_event_del_timer(ngx_event_t *ev)
@@ -55,9 +73,14 @@ ngx_inline static void ngx_event_del_timer(ngx_event_t *ev)
         return;
     }
 
-    ngx_rbtree_delete((ngx_rbtree_t **) &ngx_event_timer_rbtree,
-                      &ngx_event_timer_sentinel,
-                      (ngx_rbtree_t *) &ev->rbtree_key);
+    if (ngx_event_timer_wheel) {
+        ngx_event_timer_wheel_del(ev);
+
+    } else {
+        ngx_rbtree_delete((ngx_rbtree_t **) &ngx_event_timer_rbtree,
+                          &ngx_event_timer_sentinel,
+                          (ngx_rbtree_t *) &ev->rbtree_key);
+    }
 
     ngx_mutex_unlock(ngx_event_timer_mutex);
 
@@ -85,6 +108,17 @@ ngx_inline static void ngx_event_add_timer(ngx_event_t *ev, ngx_msec_t timer)
 
     if (ev->timer_set) {
 
+        if (key >= ev->rbtree_key && key - ev->rbtree_key < ngx_event_timer_lazy)
+        {
+            ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                           "event timer lazy: %d, old: %d, new: %d",
+                            ngx_event_ident(ev->data), ev->rbtree_key, key);
+
+            ev->timer_key = key;
+            ngx_event_timer_lazy_n++;
+            return;
+        }
+
         /*
          * Use the previous timer value if a difference between them is less
          * then 100 milliseconds.  It allows to minimize the rbtree operations
@@ -95,6 +129,8 @@ ngx_inline static void ngx_event_add_timer(ngx_event_t *ev, ngx_msec_t timer)
             ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
                            "event timer: %d, old: %d, new: %d",
                             ngx_event_ident(ev->data), ev->rbtree_key, key);
+
+            ev->timer_key = ev->rbtree_key;
             return;
         }
 
@@ -102,6 +138,7 @@ ngx_inline static void ngx_event_add_timer(ngx_event_t *ev, ngx_msec_t timer)
     }
 
     ev->rbtree_key = key;
+    ev->timer_key = key;
 
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
                    "event timer add: %d: %d",
@@ -111,9 +148,14 @@ ngx_inline static void ngx_event_add_timer(ngx_event_t *ev, ngx_msec_t timer)
         return;
     }
 
-    ngx_rbtree_insert((ngx_rbtree_t **) &ngx_event_timer_rbtree,
-                      &ngx_event_timer_sentinel,
-                      (ngx_rbtree_t *) &ev->rbtree_key);
+    if (ngx_event_timer_wheel) {
+        ngx_event_timer_wheel_add(ev);
+
+    } else {
+        ngx_rbtree_insert((ngx_rbtree_t **) &ngx_event_timer_rbtree,
+                          &ngx_event_timer_sentinel,
+                          (ngx_rbtree_t *) &ev->rbtree_key);
+    }
 
     ngx_mutex_unlock(ngx_event_timer_mutex);
 
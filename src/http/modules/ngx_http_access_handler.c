@@ -11,15 +11,17 @@
 
 /* AF_INET only */
 
-typedef struct {
-    in_addr_t     mask;
-    in_addr_t     addr;
-    unsigned      deny;
-} ngx_http_access_rule_t;
+/*
+ * the rules are compiled into the radix tree in the host byte order,
+ * the value 0 of the tree means that there is no matching rule
+ */
+
+#define NGX_HTTP_ACCESS_ALLOW  1
+#define NGX_HTTP_ACCESS_DENY   2
 
 
 typedef struct {
-    ngx_array_t  *rules;     /* array of ngx_http_access_rule_t */
+    ngx_radix_tree_t  *rules;
 } ngx_http_access_loc_conf_t;
 
 
@@ -29,6 +31,8 @@ static char *ngx_http_access_rule(ngx_conf_t *cf, ngx_command_t *cmd,
 static void *ngx_http_access_create_loc_conf(ngx_conf_t *cf);
 static char *ngx_http_access_merge_loc_conf(ngx_conf_t *cf,
                                             void *parent, void *child);
+static ngx_uint_t ngx_http_access_shadowed(ngx_radix_tree_t *tree,
+                                           uint32_t addr, uint32_t mask);
 static ngx_int_t ngx_http_access_init(ngx_cycle_t *cycle);
 
 
@@ -79,9 +83,8 @@ ngx_module_t  ngx_http_access_module = {
 
 static ngx_int_t ngx_http_access_handler(ngx_http_request_t *r)
 {
-    ngx_uint_t                   i;
+    uintptr_t                    rule;
     struct sockaddr_in          *addr_in;
-    ngx_http_access_rule_t      *rule;
     ngx_http_access_loc_conf_t  *alcf;
 
     alcf = ngx_http_get_module_loc_conf(r, ngx_http_access_module);
@@ -94,22 +97,17 @@ static ngx_int_t ngx_http_access_handler(ngx_http_request_t *r)
 
     addr_in = (struct sockaddr_in *) r->connection->sockaddr;
 
-    rule = alcf->rules->elts;
-    for (i = 0; i < alcf->rules->nelts; i++) {
-
-ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0, "%08X %08X %08X",
-               addr_in->sin_addr.s_addr, rule[i].mask, rule[i].addr);
+    rule = ngx_radix32tree_find(alcf->rules,
+                                (uint32_t) ntohl(addr_in->sin_addr.s_addr));
 
-        if ((addr_in->sin_addr.s_addr & rule[i].mask) == rule[i].addr) {
-            if (rule[i].deny) {
-                ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
-                              "access forbidden by rule");
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "access: %08X %d", addr_in->sin_addr.s_addr, (int) rule);
 
-                return NGX_HTTP_FORBIDDEN;
-            }
+    if (rule == NGX_HTTP_ACCESS_DENY) {
+        ngx_log_error(NGX_LOG_ERR, r->connection->log, 0,
+                      "access forbidden by rule");
 
-            return NGX_OK;
-        }
+        return NGX_HTTP_FORBIDDEN;
     }
 
     return NGX_OK;
@@ -121,54 +119,94 @@ static char *ngx_http_access_rule(ngx_conf_t *cf, ngx_command_t *cmd,
 {
     ngx_http_access_loc_conf_t *alcf = conf;
 
-    ngx_str_t               *value;
-    ngx_inet_cidr_t          in_cidr;
-    ngx_http_access_rule_t  *rule;
+    uint32_t          addr, mask;
+    uintptr_t         rule;
+    ngx_str_t        *value;
+    ngx_inet_cidr_t   in_cidr;
 
     if (alcf->rules == NULL) {
-        alcf->rules = ngx_create_array(cf->pool, 5,
-                                       sizeof(ngx_http_access_rule_t));
-        if (alcf->rules == NULL) {
+        if (!(alcf->rules = ngx_radix_tree_create(cf->pool))) {
             return NGX_CONF_ERROR;
         }
     }
 
-    if (!(rule = ngx_push_array(alcf->rules))) {
-        return NGX_CONF_ERROR;
-    }
-
     value = cf->args->elts;
 
-    rule->deny = (value[0].data[0] == 'd') ? 1 : 0;
+    rule = (value[0].data[0] == 'd') ? NGX_HTTP_ACCESS_DENY:
+                                       NGX_HTTP_ACCESS_ALLOW;
 
     if (value[1].len == 3 && ngx_strcmp(value[1].data, "all") == 0) {
-        rule->mask = 0;
-        rule->addr = 0;
+        addr = 0;
+        mask = 0;
 
-        return NGX_CONF_OK;
-    }
+    } else if ((in_cidr.addr = inet_addr((char *) value[1].data))
+                                                                != INADDR_NONE)
+    {
+        addr = (uint32_t) ntohl(in_cidr.addr);
+        mask = 0xffffffff;
+
+    } else if (ngx_ptocidr(&value[1], &in_cidr) == NGX_OK) {
+        addr = (uint32_t) ntohl(in_cidr.addr);
+        mask = (uint32_t) ntohl(in_cidr.mask);
 
-    rule->addr = inet_addr((char *) value[1].data);
+    } else {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "invalid paramter \"%s\"",
+                           value[1].data);
+        return NGX_CONF_ERROR;
+    }
 
-    if (rule->addr != INADDR_NONE) {
-        rule->mask = 0xffffffff;
+    /*
+     * the first matching rule wins while the radix tree finds the longest
+     * matching prefix, they are the same if the rule that is covered by
+     * a previous one is not added at all
+     */
 
+    if (ngx_http_access_shadowed(alcf->rules, addr, mask)) {
         return NGX_CONF_OK;
     }
 
-    if (ngx_ptocidr(&value[1], &in_cidr) == NGX_ERROR) {
-        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0, "invalid paramter \"%s\"",
-                           value[1].data);
+    if (ngx_radix32tree_insert(alcf->rules, addr, mask, rule) == NGX_ERROR) {
         return NGX_CONF_ERROR;
     }
 
-    rule->mask = in_cidr.mask;
-    rule->addr = in_cidr.addr;
-
     return NGX_CONF_OK;
 }
 
 
+static ngx_uint_t ngx_http_access_shadowed(ngx_radix_tree_t *tree,
+                                           uint32_t addr, uint32_t mask)
+{
+    uint32_t           bit;
+    ngx_radix_node_t  *node;
+
+    bit = 0x80000000;
+    node = tree->root;
+
+    for ( ;; ) {
+        if (node->value) {
+            return 1;
+        }
+
+        if (!(bit & mask)) {
+            return 0;
+        }
+
+        if (addr & bit) {
+            node = node->right;
+
+        } else {
+            node = node->left;
+        }
+
+        if (node == NULL) {
+            return 0;
+        }
+
+        bit >>= 1;
+    }
+}
+
+
 static void *ngx_http_access_create_loc_conf(ngx_conf_t *cf)
 {
     ngx_http_access_loc_conf_t  *conf;
@@ -191,6 +229,18 @@ static char *ngx_http_access_merge_loc_conf(ngx_conf_t *cf,
         conf->rules = prev->rules;
     }
 
+    /* the inherited rules are compiled once for all locations */
+
+    if (conf->rules && conf->rules->table == NULL) {
+        if (ngx_radix_tree_compile(conf->rules) != NGX_OK) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "could not compile the \"allow\" and "
+                               "\"deny\" rules, there are too many "
+                               "rules or not enough memory");
+            return NGX_CONF_ERROR;
+        }
+    }
+
     return NGX_CONF_OK;
 }
 
@@ -9,10 +9,26 @@
 #include <ngx_http.h>
 
 
+/*
+ * the UTF-8 recoding table has 4 bytes for every source byte:
+ * the length and up to 3 bytes of the UTF-8 sequence
+ */
+
+#define NGX_HTTP_CHARSET_UTF8_LEN  4
+
+
 typedef struct {
-    char       **tables;
-    ngx_str_t    name;
-    unsigned     server;
+    u_char      *table;
+    unsigned     ascii:1;               /* the table keeps ASCII as is */
+    unsigned     utf8:1;
+} ngx_http_charset_recode_t;
+
+
+typedef struct {
+    ngx_http_charset_recode_t  *tables;
+    ngx_str_t                   name;
+    unsigned                    server:1;
+    unsigned                    utf8:1;
 } ngx_http_charset_t;
 
 
@@ -20,7 +36,9 @@ typedef struct {
     ngx_int_t   src;
     ngx_int_t   dst;
     char       *src2dst;
-    char       *dst2src;
+    char       *dst2src;               /* NULL for UTF-8 */
+    unsigned    ascii:1;
+    unsigned    utf8:1;
 } ngx_http_charset_tables_t;
 
 
@@ -36,16 +54,30 @@ typedef struct {
 
     ngx_int_t   default_charset;
     ngx_int_t   source_charset;
+
+    ngx_bufs_t  bufs;
 } ngx_http_charset_loc_conf_t;
 
 
 typedef struct {
-    ngx_int_t   server;
-    ngx_int_t   client;
+    ngx_int_t     server;
+    ngx_int_t     client;
+
+    ngx_chain_t  *in;
+    ngx_chain_t  *free;
+    ngx_chain_t  *busy;
+
+    ngx_int_t     bufs;
 } ngx_http_charset_ctx_t;
 
 
-static void ngx_charset_recode(ngx_buf_t *b, char *table);
+static void ngx_charset_recode(ngx_buf_t *b,
+                               ngx_http_charset_recode_t *recode);
+static ngx_int_t ngx_http_charset_recode_to_utf8(ngx_http_request_t *r,
+    ngx_http_charset_ctx_t *ctx, ngx_http_charset_loc_conf_t *lcf,
+    u_char *table, ngx_chain_t *in);
+static u_char *ngx_charset_recode_to_utf8(u_char *table, u_char *src,
+                                          u_char *last, ngx_buf_t *b);
 
 static char *ngx_charset_map_block(ngx_conf_t *cf, ngx_command_t *cmd,
                                    void *conf);
@@ -101,6 +133,13 @@ static ngx_command_t  ngx_http_charset_filter_commands[] = {
       offsetof(ngx_http_charset_loc_conf_t, autodetect),
       NULL },
 
+    { ngx_string("charset_buffers"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE2,
+      ngx_conf_set_bufs_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_charset_loc_conf_t, bufs),
+      NULL },
+
       ngx_null_command
 };
 
@@ -157,6 +196,14 @@ static ngx_int_t ngx_http_charset_header_filter(ngx_http_request_t *r)
         return ngx_http_next_header_filter(r);
     }
 
+    /* the encoded body, e.g. the precompressed "file.gz", is not recoded */
+
+    if (r->headers_out.content_encoding
+        && r->headers_out.content_encoding->value.len)
+    {
+        return ngx_http_next_header_filter(r);
+    }
+
     if (ngx_strncasecmp(r->headers_out.content_type->value.data,
                                                               "text/", 5) != 0
         && ngx_strncasecmp(r->headers_out.content_type->value.data,
@@ -198,6 +245,16 @@ static ngx_int_t ngx_http_charset_header_filter(ngx_http_request_t *r)
 
     r->filter_need_in_memory = 1;
 
+    /* the UTF-8 recoded body is longer than the source one */
+
+    if (charsets[lcf->source_charset].tables[lcf->default_charset].utf8) {
+        r->headers_out.content_length_n = -1;
+        if (r->headers_out.content_length) {
+            r->headers_out.content_length->key.len = 0;
+            r->headers_out.content_length = NULL;
+        }
+    }
+
     return ngx_http_next_header_filter(r);
 }
 
@@ -205,10 +262,10 @@ static ngx_int_t ngx_http_charset_header_filter(ngx_http_request_t *r)
 static ngx_int_t ngx_http_charset_body_filter(ngx_http_request_t *r,
                                               ngx_chain_t *in)
 {
-    char                          *table;
     ngx_chain_t                   *cl;
     ngx_http_charset_t            *charsets;
     ngx_http_charset_ctx_t        *ctx;
+    ngx_http_charset_recode_t     *recode;
     ngx_http_charset_loc_conf_t   *lcf;
     ngx_http_charset_main_conf_t  *mcf;
 
@@ -222,24 +279,205 @@ static ngx_int_t ngx_http_charset_body_filter(ngx_http_request_t *r,
     lcf = ngx_http_get_module_loc_conf(r, ngx_http_charset_filter_module);
 
     charsets = mcf->charsets.elts;
-    table = charsets[lcf->source_charset].tables[lcf->default_charset];
+    recode = &charsets[lcf->source_charset].tables[lcf->default_charset];
+
+    if (recode->utf8) {
+        return ngx_http_charset_recode_to_utf8(r, ctx, lcf, recode->table, in);
+    }
 
     for (cl = in; cl; cl = cl->next) {
-        ngx_charset_recode(cl->buf, table);
+        ngx_charset_recode(cl->buf, recode);
     }
 
     return ngx_http_next_body_filter(r, in);
 }
 
 
-static void ngx_charset_recode(ngx_buf_t *b, char *table)
+static void ngx_charset_recode(ngx_buf_t *b,
+                               ngx_http_charset_recode_t *recode)
+{
+    u_char  *p, *last, *table, c;
+
+    table = recode->table;
+    last = b->last;
+
+    if (!recode->ascii) {
+        for (p = b->pos; p < last; p++) {
+            c = *p;
+            *p = table[c];
+        }
+
+        return;
+    }
+
+    /* the ASCII runs are skipped by the vectorized scan */
+
+    for (p = b->pos; p < last; /* void */) {
+        p = ngx_strlascii(p, last);
+
+        for (/* void */; p < last && *p >= 0x80; p++) {
+            c = *p;
+            *p = table[c];
+        }
+    }
+}
+
+
+/*
+ * the UTF-8 recoding changes the length, so the source bufs are not changed,
+ * and the recoded data are copied to the own "charset_buffers" bufs that
+ * are reused after they have been sent; if all of them are busy then
+ * the source buf is left at the first byte that is not recoded yet,
+ * so the file or the upstream is not read further until the bufs are sent
+ */
+
+static ngx_int_t ngx_http_charset_recode_to_utf8(ngx_http_request_t *r,
+    ngx_http_charset_ctx_t *ctx, ngx_http_charset_loc_conf_t *lcf,
+    u_char *table, ngx_chain_t *in)
+{
+    ngx_int_t     rc;
+    ngx_buf_t    *b, *buf;
+    ngx_chain_t  *cl, *out, **ll;
+
+    if (in) {
+        if (ngx_chain_add_copy(r->pool, &ctx->in, in) == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+    }
+
+    for ( ;; ) {
+
+        out = NULL;
+        ll = &out;
+        b = NULL;
+
+        while (ctx->in) {
+            buf = ctx->in->buf;
+
+            if (buf->pos < buf->last) {
+
+                if (b == NULL) {
+                    if (ctx->free) {
+                        cl = ctx->free;
+                        b = cl->buf;
+                        ctx->free = cl->next;
+                        ngx_free_chain(cl);
+
+                        b->flush = 0;
+                        b->last_buf = 0;
+
+                    } else if (ctx->bufs < lcf->bufs.num) {
+                        b = ngx_create_temp_buf(r->pool, lcf->bufs.size);
+                        if (b == NULL) {
+                            return NGX_ERROR;
+                        }
+
+                        b->tag = (ngx_buf_tag_t)
+                                               &ngx_http_charset_filter_module;
+                        b->recycled = 1;
+                        ctx->bufs++;
+
+                    } else {
+                        break;
+                    }
+
+                    ngx_alloc_link_and_set_buf(cl, b, r->pool, NGX_ERROR);
+                    *ll = cl;
+                    ll = &cl->next;
+                }
+
+                buf->pos = ngx_charset_recode_to_utf8(table, buf->pos,
+                                                      buf->last, b);
+
+                if (buf->pos < buf->last) {
+                    /* the buf is full */
+                    b = NULL;
+                    continue;
+                }
+            }
+
+            if (buf->last_buf || buf->flush) {
+
+                if (b == NULL) {
+                    if (!(b = ngx_calloc_buf(r->pool))) {
+                        return NGX_ERROR;
+                    }
+
+                    ngx_alloc_link_and_set_buf(cl, b, r->pool, NGX_ERROR);
+                    *ll = cl;
+                    ll = &cl->next;
+                }
+
+                b->last_buf = buf->last_buf;
+                b->flush = buf->flush;
+
+                b = NULL;
+            }
+
+            ctx->in = ctx->in->next;
+        }
+
+        rc = ngx_http_next_body_filter(r, out);
+
+        ngx_chain_update_chains(&ctx->free, &ctx->busy, &out,
+                                (ngx_buf_tag_t)
+                                              &ngx_http_charset_filter_module);
+
+        if (rc == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        /* the downstream filters may free some bufs for the rest */
+
+        if (ctx->in == NULL || ctx->free == NULL) {
+            return rc;
+        }
+    }
+}
+
+
+static u_char *ngx_charset_recode_to_utf8(u_char *table, u_char *src,
+                                          u_char *last, ngx_buf_t *b)
 {
-    u_char  *p, c;
+    u_char  *p, *dst, *end;
+    size_t   n;
+
+    dst = b->last;
+    end = b->end;
+
+    while (src < last) {
+
+        /* the ASCII run is copied as is */
+
+        p = ngx_strlascii(src, last);
+
+        n = p - src;
+        if (n > (size_t) (end - dst)) {
+            n = end - dst;
+        }
+
+        dst = ngx_cpymem(dst, src, n);
+        src += n;
+
+        if (src < p) {
+            break;
+        }
 
-    for (p = b->pos; p < b->last; p++) {
-        c = *p;
-        *p = table[c];
+        for (/* void */; src < last && *src >= 0x80; src++) {
+            p = &table[*src * NGX_HTTP_CHARSET_UTF8_LEN];
+
+            if ((size_t) (end - dst) < p[0]) {
+                b->last = dst;
+                return src;
+            }
+
+            dst = ngx_cpymem(dst, p + 1, p[0]);
+        }
     }
+
+    b->last = dst;
+
+    return src;
 }
 
 
@@ -249,10 +487,12 @@ static char *ngx_charset_map_block(ngx_conf_t *cf, ngx_command_t *cmd,
     ngx_http_charset_main_conf_t  *mcf = conf;
 
     char                       *rv;
+    u_char                     *p;
     ngx_int_t                   src, dst;
     ngx_uint_t                  i;
     ngx_str_t                  *value;
     ngx_conf_t                  pvcf;
+    ngx_http_charset_t         *charset;
     ngx_http_charset_tables_t  *table;
 
     value = cf->args->elts;
@@ -275,6 +515,16 @@ static char *ngx_charset_map_block(ngx_conf_t *cf, ngx_command_t *cmd,
         return NGX_CONF_ERROR;
     }
 
+    charset = mcf->charsets.elts;
+
+    if (charset[src].utf8) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"charset_map\" from \"%s\" is not supported, "
+                           "UTF-8 may be the second charset only",
+                           value[1].data);
+        return NGX_CONF_ERROR;
+    }
+
     table = mcf->tables.elts;
     for (i = 0; i < mcf->tables.nelts; i++) {
         if ((src == table->src && dst == table->dst)
@@ -294,6 +544,28 @@ static char *ngx_charset_map_block(ngx_conf_t *cf, ngx_command_t *cmd,
 
     table->src = src;
     table->dst = dst;
+    table->ascii = 1;
+    table->utf8 = charset[dst].utf8;
+
+    if (table->utf8) {
+
+        /* the bytes above 0x7f are recoded to "?" until they are mapped */
+
+        table->src2dst = ngx_palloc(cf->pool, 256 * NGX_HTTP_CHARSET_UTF8_LEN);
+        if (table->src2dst == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        table->dst2src = NULL;
+
+        for (i = 0; i < 256; i++) {
+            p = (u_char *) &table->src2dst[i * NGX_HTTP_CHARSET_UTF8_LEN];
+            p[0] = 1;
+            p[1] = (u_char) (i < 128 ? i : '?');
+        }
+
+        goto map;
+    }
 
     if (!(table->src2dst = ngx_palloc(cf->pool, 256))) {
         return NGX_CONF_ERROR;
@@ -313,6 +585,8 @@ static char *ngx_charset_map_block(ngx_conf_t *cf, ngx_command_t *cmd,
         table->dst2src[i] = '?';
     }
 
+map:
+
     pvcf = *cf;
     cf->ctx = table;
     cf->handler = ngx_charset_map;
@@ -326,7 +600,9 @@ static char *ngx_charset_map_block(ngx_conf_t *cf, ngx_command_t *cmd,
 
 static char *ngx_charset_map(ngx_conf_t *cf, ngx_command_t *dummy, void *conf)
 {
+    u_char                     *p;
     ngx_int_t                   src, dst;
+    ngx_uint_t                  i;
     ngx_str_t                  *value;
     ngx_http_charset_tables_t  *table;
 
@@ -344,6 +620,40 @@ static char *ngx_charset_map(ngx_conf_t *cf, ngx_command_t *dummy, void *conf)
         return NGX_CONF_ERROR;
     }
 
+    table = cf->ctx;
+
+    if (table->utf8) {
+
+        /* the UTF-8 sequence of 1 to 3 bytes, e.g. "D0B0", ASCII is kept */
+
+        if (src < 0x80
+            || value[1].len < 2
+            || value[1].len > 2 * (NGX_HTTP_CHARSET_UTF8_LEN - 1)
+            || value[1].len % 2)
+        {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "invalid value \"%s\"", value[1].data);
+            return NGX_CONF_ERROR;
+        }
+
+        p = (u_char *) &table->src2dst[src * NGX_HTTP_CHARSET_UTF8_LEN];
+
+        for (i = 0; i < value[1].len / 2; i++) {
+            dst = ngx_hextoi(&value[1].data[i * 2], 2);
+            if (dst == NGX_ERROR) {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid value \"%s\"", value[1].data);
+                return NGX_CONF_ERROR;
+            }
+
+            p[i + 1] = (u_char) dst;
+        }
+
+        p[0] = (u_char) i;
+
+        return NGX_CONF_OK;
+    }
+
     dst = ngx_hextoi(value[1].data, value[1].len);
     if (dst == NGX_ERROR || dst > 255) {
         ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
@@ -351,7 +661,9 @@ static char *ngx_charset_map(ngx_conf_t *cf, ngx_command_t *dummy, void *conf)
         return NGX_CONF_ERROR;
     }
 
-    table = cf->ctx;
+    if (src != dst && (src < 0x80 || dst < 0x80)) {
+        table->ascii = 0;
+    }
 
     table->src2dst[src] = (char) dst;
     table->dst2src[dst] = (char) src;
@@ -419,7 +731,10 @@ static ngx_int_t ngx_http_add_charset(ngx_array_t *charsets, ngx_str_t *name)
         return NGX_ERROR;
     }
 
+    c->tables = NULL;
     c->name = *name;
+    c->server = 0;
+    c->utf8 = (name->len == 5 && ngx_strcasecmp(name->data, "utf-8") == 0);
 
     return i;
 }
@@ -461,6 +776,7 @@ static char *ngx_http_charset_init_main_conf(ngx_conf_t *cf, void *conf)
 
     ngx_uint_t                  i, n;
     ngx_http_charset_t         *charset;
+    ngx_http_charset_recode_t  *recode;
     ngx_http_charset_tables_t  *tables;
 
     tables = mcf->tables.elts;
@@ -472,7 +788,8 @@ static char *ngx_http_charset_init_main_conf(ngx_conf_t *cf, void *conf)
         }
 
         charset[i].tables = ngx_pcalloc(cf->pool,
-                                        sizeof(char *) * mcf->charsets.nelts);
+                                        sizeof(ngx_http_charset_recode_t)
+                                        * mcf->charsets.nelts);
 
         if (charset[i].tables == NULL) {
             return NGX_CONF_ERROR;
@@ -480,12 +797,19 @@ static char *ngx_http_charset_init_main_conf(ngx_conf_t *cf, void *conf)
 
         for (n = 0; n < mcf->tables.nelts; n++) {
             if ((ngx_int_t) i == tables[n].src) {
-                charset[i].tables[tables[n].dst] = tables[n].src2dst;
+                recode = &charset[i].tables[tables[n].dst];
+                recode->table = (u_char *) tables[n].src2dst;
+                recode->ascii = tables[n].ascii;
+                recode->utf8 = tables[n].utf8;
                 continue;
             }
 
-            if ((ngx_int_t) i == tables[n].dst) {
-                charset[i].tables[tables[n].src] = tables[n].dst2src;
+            /* there is no recoding from UTF-8 */
+
+            if ((ngx_int_t) i == tables[n].dst && tables[n].dst2src) {
+                recode = &charset[i].tables[tables[n].src];
+                recode->table = (u_char *) tables[n].dst2src;
+                recode->ascii = tables[n].ascii;
             }
         }
     }
@@ -500,7 +824,7 @@ static char *ngx_http_charset_init_main_conf(ngx_conf_t *cf, void *conf)
                 continue;
             }
 
-            if (charset[i].tables[n]) {
+            if (charset[i].tables[n].table) {
                 continue;
             }
 
@@ -529,6 +853,8 @@ static void *ngx_http_charset_create_loc_conf(ngx_conf_t *cf)
     lcf->default_charset = NGX_CONF_UNSET;
     lcf->source_charset = NGX_CONF_UNSET;
 
+    /* lcf->bufs.num = 0; set by ngx_pcalloc() */
+
     return lcf;
 }
 
@@ -549,5 +875,16 @@ static char *ngx_http_charset_merge_loc_conf(ngx_conf_t *cf,
     ngx_conf_merge_value(conf->default_charset, prev->default_charset,
                          conf->source_charset);
 
+    ngx_conf_merge_bufs_value(conf->bufs, prev->bufs, 4, ngx_pagesize);
+
+    /* the buf must hold the longest UTF-8 sequence */
+
+    if (conf->bufs.size < NGX_HTTP_CHARSET_UTF8_LEN - 1) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"charset_buffers\" size must be at least %d",
+                           NGX_HTTP_CHARSET_UTF8_LEN - 1);
+        return NGX_CONF_ERROR;
+    }
+
     return NGX_CONF_OK;
 }
@@ -63,7 +63,7 @@ static ngx_int_t ngx_http_chunked_body_filter(ngx_http_request_t *r,
                                               ngx_chain_t *in)
 {
     u_char       *chunk;
-    size_t        size, len;
+    size_t        size;
     ngx_buf_t    *b;
     ngx_chain_t   out, tail, *cl, *tl, **ll;
 
@@ -96,13 +96,16 @@ static ngx_int_t ngx_http_chunked_body_filter(ngx_http_request_t *r,
     }
 
     if (size) {
-        ngx_test_null(chunk, ngx_palloc(r->pool, 11), NGX_ERROR);
-        len = ngx_snprintf((char *) chunk, 11, SIZE_T_X_FMT CRLF, size);
+        /* the hex digits of size_t and CRLF */
+
+        ngx_test_null(chunk, ngx_palloc(r->pool, 2 * sizeof(size_t) + 2),
+                      NGX_ERROR);
 
         ngx_test_null(b, ngx_calloc_buf(r->pool), NGX_ERROR);
         b->temporary = 1;
         b->pos = chunk;
-        b->last = chunk + len;
+        b->last = ngx_sprint_hex(chunk, size);
+        *(b->last++) = CR; *(b->last++) = LF;
 
         out.buf = b;
     }
@@ -7,6 +7,9 @@
 #include <ngx_config.h>
 #include <ngx_core.h>
 #include <ngx_http.h>
+#if (NGX_THREADS)
+#include <ngx_channel.h>
+#endif
 
 #include <zlib.h>
 
@@ -14,6 +17,7 @@
 typedef struct {
     ngx_flag_t           enable;
     ngx_flag_t           no_buffer;
+    ngx_flag_t           cache;
 
     ngx_bufs_t           bufs;
 
@@ -21,9 +25,11 @@ typedef struct {
     ngx_uint_t           proxied;
 
     int                  level;
+    ngx_int_t            level_min;
     size_t               wbits;
     size_t               memlevel;
     ssize_t              min_length;
+    ssize_t              thread_min_length;
 } ngx_http_gzip_conf_t;
 
 
@@ -38,6 +44,97 @@ typedef struct {
 #define NGX_HTTP_GZIP_PROXIED_ANY       0x0200
 
 
+/*
+ * the shared cache of the compressed static files, the files are identified
+ * by the inode, mtime and size, the cache has the hash of the entries
+ * and the LRU list, the least recently used entries are evicted if
+ * there is no memory for a new entry
+ */
+
+#define NGX_HTTP_GZIP_CACHE_MIN_SIZE  (64 * 1024)
+
+
+typedef struct {
+    ngx_file_uniq_t      uniq;
+    time_t               mtime;
+    off_t                size;
+    ngx_uint_t           level;
+} ngx_http_gzip_cache_key_t;
+
+
+typedef struct ngx_http_gzip_cache_node_s  ngx_http_gzip_cache_node_t;
+
+struct ngx_http_gzip_cache_node_s {
+    ngx_http_gzip_cache_node_t   *next;          /* in the bucket */
+    ngx_http_gzip_cache_node_t   *lru_prev;
+    ngx_http_gzip_cache_node_t   *lru_next;
+
+    uint32_t                      hash;
+    ngx_http_gzip_cache_key_t     key;
+
+    size_t                        len;
+    u_char                       *data;
+};
+
+
+typedef struct {
+    ngx_http_gzip_cache_stat_t    stat;
+
+    size_t                        max_size;
+
+    ngx_uint_t                    nbuckets;
+    ngx_http_gzip_cache_node_t  **buckets;
+
+    /* the sentinel, lru.lru_next is the most recently used entry */
+    ngx_http_gzip_cache_node_t    lru;
+} ngx_http_gzip_cache_t;
+
+
+/*
+ * the zlib deflate state with its memory, the states are kept
+ * in the worker free list after the response has been compressed
+ * and are reused by deflateReset() for the same parameters
+ */
+
+typedef struct ngx_http_gzip_state_s  ngx_http_gzip_state_t;
+
+struct ngx_http_gzip_state_s {
+    z_stream                zstream;
+    ngx_http_gzip_state_t  *next;
+
+    int                     level;
+    int                     wbits;
+    int                     memlevel;
+
+    char                   *free_mem;
+    ngx_uint_t              allocated;
+
+#if (NGX_THREADS)
+    ngx_http_request_t     *request;       /* NULL if it has been closed */
+    int                     flush;
+    int                     rc;
+
+    /* the buffers of the request while the thread deflates */
+    Bytef                  *next_in;
+    uInt                    avail_in;
+    Bytef                  *next_out;
+    uInt                    avail_out;
+
+    u_char                 *thread_in;
+    u_char                 *thread_out;
+#endif
+};
+
+
+/* the maximum number of the idle states in the worker */
+
+#define NGX_HTTP_GZIP_FREE_STATES  32
+
+/* the maximum input and output of the one thread deflate() */
+
+#define NGX_HTTP_GZIP_THREAD_CHUNK  65536
+
+
 typedef struct {
     ngx_chain_t         *in;
     ngx_chain_t         *free;
@@ -49,14 +146,21 @@ typedef struct {
     ngx_int_t            bufs;
 
     off_t                length;
+    int                  level;
 
-    void                *preallocated;
-    char                *free_mem;
-    ngx_uint_t           allocated;
+    ngx_http_gzip_state_t  *state;
 
     unsigned             flush:4;
     unsigned             redo:1;
     unsigned             done:1;
+
+    unsigned             cache:1;          /* the copy is being filled */
+    unsigned             hit:1;
+
+#if (NGX_THREADS)
+    unsigned             thread_busy:1;
+    unsigned             thread_done:1;
+#endif
 #if 0
     unsigned             pass:1;
     unsigned             blocked:1;
@@ -66,8 +170,14 @@ typedef struct {
     size_t               zout;
 
     uint32_t             crc32;
-    z_stream             zstream;
+    z_stream            *zstream;
     ngx_http_request_t  *request;
+
+    ngx_http_gzip_cache_key_t  key;
+    ngx_buf_t                 *cached;
+    u_char                    *cache_start;
+    u_char                    *cache_last;
+    u_char                    *cache_end;
 } ngx_http_gzip_ctx_t;
 
 
@@ -76,8 +186,42 @@ static ngx_int_t ngx_http_gzip_proxied(ngx_http_request_t *r,
 static void *ngx_http_gzip_filter_alloc(void *opaque, u_int items,
                                         u_int size);
 static void ngx_http_gzip_filter_free(void *opaque, void *address);
+static ngx_http_gzip_state_t *ngx_http_gzip_get_state(ngx_http_request_t *r,
+                                                      int level, int wbits,
+                                                      int memlevel);
+static void ngx_http_gzip_put_state(ngx_http_gzip_state_t *state);
+static void ngx_http_gzip_free_state(ngx_http_gzip_state_t *state);
+static void ngx_http_gzip_cleanup_state(void *data);
+#if (NGX_THREADS)
+static ngx_int_t ngx_http_gzip_thread_deflate(ngx_http_request_t *r,
+                                              ngx_http_gzip_ctx_t *ctx,
+                                              int *rc);
+static int ngx_http_gzip_thread_result(ngx_http_gzip_ctx_t *ctx);
+static ngx_int_t ngx_http_gzip_thread_send(ngx_http_request_t *r,
+                                           ngx_http_gzip_ctx_t *ctx);
+static ngx_int_t ngx_http_gzip_thread_wait(ngx_http_request_t *r);
+static void *ngx_http_gzip_thread_cycle(void *data);
+static void ngx_http_gzip_thread_handler(ngx_event_t *ev);
+#endif
 ngx_inline static int ngx_http_gzip_error(ngx_http_gzip_ctx_t *ctx);
 
+static ngx_int_t ngx_http_gzip_send_cached(ngx_http_request_t *r,
+                                           ngx_http_gzip_ctx_t *ctx,
+                                           ngx_chain_t *in);
+static void ngx_http_gzip_cache_copy(ngx_http_gzip_ctx_t *ctx, u_char *p,
+                                     u_char *last);
+static ngx_buf_t *ngx_http_gzip_cache_get(ngx_http_request_t *r,
+                                          ngx_http_gzip_cache_key_t *key);
+static void ngx_http_gzip_cache_put(ngx_http_gzip_cache_key_t *key,
+                                    u_char *data, size_t len);
+static ngx_http_gzip_cache_node_t *ngx_http_gzip_cache_lookup(
+    ngx_http_gzip_cache_t *cache, ngx_http_gzip_cache_key_t *key,
+    uint32_t hash);
+static void ngx_http_gzip_cache_evict(ngx_http_gzip_cache_t *cache);
+
+static int ngx_http_gzip_level(ngx_http_gzip_conf_t *conf);
+static void ngx_http_gzip_adapt();
+
 static u_char *ngx_http_gzip_log_ratio(ngx_http_request_t *r, u_char *buf,
                                        uintptr_t data);
 
@@ -88,6 +232,15 @@ static char *ngx_http_gzip_merge_conf(ngx_conf_t *cf,
                                       void *parent, void *child);
 static char *ngx_http_gzip_set_window(ngx_conf_t *cf, void *post, void *data);
 static char *ngx_http_gzip_set_hash(ngx_conf_t *cf, void *post, void *data);
+static char *ngx_http_gzip_set_cache_zone(ngx_conf_t *cf, ngx_command_t *cmd,
+                                          void *conf);
+static char *ngx_http_gzip_set_adaptive(ngx_conf_t *cf, ngx_command_t *cmd,
+                                        void *conf);
+#if (NGX_THREADS)
+static ngx_int_t ngx_http_gzip_init_process(ngx_cycle_t *cycle);
+static char *ngx_http_gzip_set_threads(ngx_conf_t *cf, ngx_command_t *cmd,
+                                       void *conf);
+#endif
 
 
 static ngx_conf_num_bounds_t  ngx_http_gzip_comp_level_bounds = {
@@ -145,6 +298,20 @@ static ngx_command_t  ngx_http_gzip_filter_commands[] = {
       offsetof(ngx_http_gzip_conf_t, level),
       &ngx_http_gzip_comp_level_bounds },
 
+    { ngx_string("gzip_comp_level_min"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_gzip_conf_t, level_min),
+      &ngx_http_gzip_comp_level_bounds },
+
+    { ngx_string("gzip_adaptive"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE2,
+      ngx_http_gzip_set_adaptive,
+      0,
+      0,
+      NULL },
+
     { ngx_string("gzip_window"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_size_slot,
@@ -187,6 +354,38 @@ static ngx_command_t  ngx_http_gzip_filter_commands[] = {
       offsetof(ngx_http_gzip_conf_t, min_length),
       NULL },
 
+    { ngx_string("gzip_cache"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_gzip_conf_t, cache),
+      NULL },
+
+    { ngx_string("gzip_cache_zone"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_http_gzip_set_cache_zone,
+      0,
+      0,
+      NULL },
+
+#if (NGX_THREADS)
+
+    { ngx_string("gzip_threads"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_http_gzip_set_threads,
+      0,
+      0,
+      NULL },
+
+    { ngx_string("gzip_thread_min_length"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_gzip_conf_t, thread_min_length),
+      NULL },
+
+#endif
+
       ngx_null_command
 };
 
@@ -211,7 +410,11 @@ ngx_module_t  ngx_http_gzip_filter_module = {
     ngx_http_gzip_filter_commands,         /* module directives */
     NGX_HTTP_MODULE,                       /* module type */
     ngx_http_gzip_filter_init,             /* init module */
+#if (NGX_THREADS)
+    ngx_http_gzip_init_process             /* init child */
+#else
     NULL                                   /* init child */
+#endif
 };
 
 
@@ -245,6 +448,35 @@ static ngx_http_output_header_filter_pt  ngx_http_next_header_filter;
 static ngx_http_output_body_filter_pt    ngx_http_next_body_filter;
 
 
+static ngx_slab_pool_t      *ngx_http_gzip_cache_pool;
+static ngx_cycle_t          *ngx_http_gzip_cache_cycle;
+
+static ngx_http_gzip_state_t  *ngx_http_gzip_states;
+static ngx_uint_t              ngx_http_gzip_nstates;
+
+#if (NGX_THREADS)
+
+static ngx_int_t               ngx_http_gzip_threads_n;
+
+/* the states to deflate and the deflated states */
+
+static int                     ngx_http_gzip_thread_tasks[2];
+static int                     ngx_http_gzip_thread_done[2];
+
+#endif
+
+/* the event loop lag and the worker CPU percent to lower the level at */
+
+static ngx_msec_t              ngx_http_gzip_adaptive_lag;
+static ngx_uint_t              ngx_http_gzip_adaptive_cpu;
+
+static ngx_epoch_msec_t        ngx_http_gzip_adapt_time;
+static ngx_epoch_msec_t        ngx_http_gzip_adapt_used;
+
+ngx_http_gzip_cache_stat_t  *ngx_http_gzip_cache_stat;
+ngx_http_gzip_level_stat_t   ngx_http_gzip_level_stat;
+
+
 static ngx_int_t ngx_http_gzip_header_filter(ngx_http_request_t *r)
 {
     ngx_http_gzip_ctx_t   *ctx;
@@ -255,13 +487,11 @@ static ngx_int_t ngx_http_gzip_header_filter(ngx_http_request_t *r)
     if (!conf->enable
         || r->headers_out.status != NGX_HTTP_OK
         || r->header_only
-        || r->http_version < conf->http_version
         || (r->headers_out.content_encoding
             && r->headers_out.content_encoding->value.len)
-        || r->headers_in.accept_encoding == NULL
         || (r->headers_out.content_length_n != -1
             && r->headers_out.content_length_n < conf->min_length)
-        || ngx_strstr(r->headers_in.accept_encoding->value.data, "gzip") == NULL
+        || ngx_http_gzip_ok(r) != NGX_OK
        )
     {
         return ngx_http_next_header_filter(r);
@@ -276,30 +506,6 @@ static ngx_int_t ngx_http_gzip_header_filter(ngx_http_request_t *r)
     }
 
 
-    if (r->headers_in.via) {
-        if (conf->proxied & NGX_HTTP_GZIP_PROXIED_OFF) {
-            return ngx_http_next_header_filter(r);
-        }
-
-        if (!(conf->proxied & NGX_HTTP_GZIP_PROXIED_ANY)
-            && ngx_http_gzip_proxied(r, conf) == NGX_DECLINED)
-        {
-            return ngx_http_next_header_filter(r);
-        }
-    }
-
-
-    /*
-     * if the URL (without the "http://" prefix) is longer than 253 bytes
-     * then MSIE 4.x can not handle the compressed stream - it waits too long,
-     * hangs up or crashes
-     */
-
-    if (r->headers_in.msie4 && r->unparsed_uri.len > 200) {
-        return ngx_http_next_header_filter(r);
-    }
-
-
     ngx_http_create_ctx(r, ctx, ngx_http_gzip_filter_module,
                         sizeof(ngx_http_gzip_ctx_t), NGX_ERROR);
     ctx->request = r;
@@ -320,12 +526,92 @@ static ngx_int_t ngx_http_gzip_header_filter(ngx_http_request_t *r)
         r->headers_out.content_length->key.len = 0;
         r->headers_out.content_length = NULL;
     }
+
+    /* the level lowered under the load is the part of the cache key too */
+
+    ctx->level = ngx_http_gzip_level(conf);
+
+    if (conf->cache
+        && ngx_http_gzip_cache_pool
+        && r->headers_out.file_uniq
+        && ctx->length > 0)
+    {
+        ngx_memzero(&ctx->key, sizeof(ngx_http_gzip_cache_key_t));
+
+        ctx->key.uniq = r->headers_out.file_uniq;
+        ctx->key.mtime = r->headers_out.last_modified_time;
+        ctx->key.size = ctx->length;
+        ctx->key.level = ctx->level;
+
+        ctx->cached = ngx_http_gzip_cache_get(r, &ctx->key);
+
+        if (ctx->cached) {
+
+            /* the file is not read, its buf is skipped by the body filter */
+
+            ctx->hit = 1;
+            ctx->zin = (size_t) ctx->length;
+            ctx->zout = ctx->cached->last - ctx->cached->pos;
+
+            r->headers_out.content_length_n = ctx->zout;
+
+            return ngx_http_next_header_filter(r);
+        }
+
+        ctx->cache = 1;
+    }
+
     r->filter_need_in_memory = 1;
 
     return ngx_http_next_header_filter(r);
 }
 
 
+/*
+ * the client checks that are common for the gzip filter and
+ * the precompressed files of the static handler
+ */
+
+ngx_int_t ngx_http_gzip_ok(ngx_http_request_t *r)
+{
+    ngx_http_gzip_conf_t  *conf;
+
+    conf = ngx_http_get_module_loc_conf(r, ngx_http_gzip_filter_module);
+
+    if (r->http_version < conf->http_version
+        || r->headers_in.accept_encoding == NULL
+        || ngx_strstr(r->headers_in.accept_encoding->value.data, "gzip") == NULL
+       )
+    {
+        return NGX_DECLINED;
+    }
+
+    if (r->headers_in.via) {
+        if (conf->proxied & NGX_HTTP_GZIP_PROXIED_OFF) {
+            return NGX_DECLINED;
+        }
+
+        if (!(conf->proxied & NGX_HTTP_GZIP_PROXIED_ANY)
+            && ngx_http_gzip_proxied(r, conf) == NGX_DECLINED)
+        {
+            return NGX_DECLINED;
+        }
+    }
+
+    /*
+     * if the URL (without the "http://" prefix) is longer than 253 bytes
+     * then MSIE 4.x can not handle the compressed stream - it waits too long,
+     * hangs up or crashes
+     */
+
+    if (r->headers_in.msie4 && r->unparsed_uri.len > 200) {
+        return NGX_DECLINED;
+    }
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t ngx_http_gzip_proxied(ngx_http_request_t *r,
                                        ngx_http_gzip_conf_t *conf)
 {
@@ -409,12 +695,15 @@ static ngx_int_t ngx_http_gzip_proxied(ngx_http_request_t *r,
 static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
                                            ngx_chain_t *in)
 {
-    int                    rc, wbits, memlevel, last;
-    struct gztrailer      *trailer;
-    ngx_buf_t             *b;
-    ngx_chain_t           *cl;
-    ngx_http_gzip_ctx_t   *ctx;
-    ngx_http_gzip_conf_t  *conf;
+    int                     rc, wbits, memlevel, last;
+    u_char                 *p;
+    size_t                  size;
+    struct gztrailer       *trailer;
+    ngx_buf_t              *b;
+    ngx_chain_t            *cl;
+    ngx_http_gzip_ctx_t    *ctx;
+    ngx_http_gzip_conf_t   *conf;
+    ngx_http_gzip_cache_t  *cache;
 
     ctx = ngx_http_get_module_ctx(r, ngx_http_gzip_filter_module);
 
@@ -422,9 +711,13 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
         return ngx_http_next_body_filter(r, in);
     }
 
+    if (ctx->hit) {
+        return ngx_http_gzip_send_cached(r, ctx, in);
+    }
+
     conf = ngx_http_get_module_loc_conf(r, ngx_http_gzip_filter_module);
 
-    if (ctx->preallocated == NULL) {
+    if (ctx->state == NULL) {
         wbits = conf->wbits;
         memlevel = conf->memlevel;
 
@@ -438,36 +731,18 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
             }
         }
 
-        /*
-         * We preallocate a memory for zlib in one buffer (200K-400K), this
-         * dicreases a number of malloc() and free() calls and also probably
-         * dicreases a number of syscalls (sbrk() or so).
-         * Besides we free this memory as soon as the gzipping will complete
-         * and do not wait while a whole response will be sent to a client.
-         *
-         * 8K is for zlib deflate_state, it takes
-         *  * 5816 bytes on x86 and sparc64 (32-bit mode)
-         *  * 5920 bytes on amd64 and sparc64
-         */
-
-        ctx->allocated = 8192 + (1 << (wbits + 2)) + (1 << (memlevel + 9));
+        ctx->state = ngx_http_gzip_get_state(r, ctx->level, wbits, memlevel);
 
-        if (!(ctx->preallocated = ngx_palloc(r->pool, ctx->allocated))) {
+        if (ctx->state == NULL) {
+            ctx->done = 1;
             return NGX_ERROR;
         }
 
-        ctx->free_mem = ctx->preallocated;
+        ctx->zstream = &ctx->state->zstream;
 
-        ctx->zstream.zalloc = ngx_http_gzip_filter_alloc;
-        ctx->zstream.zfree = ngx_http_gzip_filter_free;
-        ctx->zstream.opaque = ctx;
-
-        rc = deflateInit2(&ctx->zstream, conf->level, Z_DEFLATED,
-                          -wbits, memlevel, Z_DEFAULT_STRATEGY);
-
-        if (rc != Z_OK) {
-            ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
-                          "deflateInit2() failed: %d", rc);
+        if (ngx_pool_cleanup_add(r->pool, ngx_http_gzip_cleanup_state, ctx)
+                                                                  == NGX_ERROR)
+        {
             return ngx_http_gzip_error(ctx);
         }
 
@@ -483,10 +758,57 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
         ctx->out = cl;
         ctx->last_out = &cl->next;
 
+        if (ctx->cache) {
+
+            /* the header, the deflated data and the trailer */
+
+            size = 10 + deflateBound(ctx->zstream, (uLong) ctx->length) + 8;
+
+            /*
+             * the response that may not fit in the cache is not copied,
+             * otherwise the whole file would be allocated in the request
+             * pool only to be rejected by ngx_http_gzip_cache_put()
+             */
+
+            cache = ngx_http_gzip_cache_pool->data;
+
+            if (size > cache->max_size) {
+                ctx->cache_start = NULL;
+
+            } else {
+                ctx->cache_start = ngx_palloc(r->pool, size);
+            }
+
+            if (ctx->cache_start) {
+                ctx->cache_last = ngx_cpymem(ctx->cache_start, gzheader, 10);
+                ctx->cache_end = ctx->cache_start + size;
+
+            } else {
+                ctx->cache = 0;
+            }
+        }
+
         ctx->crc32 = crc32(0L, Z_NULL, 0);
         ctx->flush = Z_NO_FLUSH;
     }
 
+#if (NGX_THREADS)
+
+    if (ctx->thread_busy) {
+
+        /* the state is used by the thread, the write event will be posted */
+
+        if (in) {
+            if (ngx_chain_add_copy(r->pool, &ctx->in, in) == NGX_ERROR) {
+                return ngx_http_gzip_error(ctx);
+            }
+        }
+
+        return ngx_http_gzip_thread_wait(r);
+    }
+
+#endif
+
     if (in) {
         if (ngx_chain_add_copy(r->pool, &ctx->in, in) == NGX_ERROR) {
             return ngx_http_gzip_error(ctx);
@@ -499,9 +821,22 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
 
         for ( ;; ) {
 
+#if (NGX_THREADS)
+
+            if (ctx->thread_done) {
+                ctx->thread_done = 0;
+
+                p = ctx->state->next_out;
+                rc = ngx_http_gzip_thread_result(ctx);
+
+                goto deflated;
+            }
+
+#endif
+
             /* does zlib need a new data ? */
 
-            if (ctx->zstream.avail_in == 0
+            if (ctx->zstream->avail_in == 0
                 && ctx->flush == Z_NO_FLUSH
                 && !ctx->redo)
             {
@@ -515,13 +850,13 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
                 ctx->in_buf = ctx->in->buf;
                 ctx->in = ctx->in->next;
 
-                ctx->zstream.next_in = ctx->in_buf->pos;
-                ctx->zstream.avail_in = ctx->in_buf->last - ctx->in_buf->pos;
+                ctx->zstream->next_in = ctx->in_buf->pos;
+                ctx->zstream->avail_in = ctx->in_buf->last - ctx->in_buf->pos;
 
                 ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                                "gzip in_buf:" PTR_FMT " ni:" PTR_FMT " ai:%d",
                                ctx->in_buf,
-                               ctx->zstream.next_in, ctx->zstream.avail_in);
+                               ctx->zstream->next_in, ctx->zstream->avail_in);
 
                 /* STUB */
                 if (ctx->in_buf->last < ctx->in_buf->pos) {
@@ -539,25 +874,27 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
                     ctx->flush = Z_SYNC_FLUSH;
                 }
 
-                if (ctx->zstream.avail_in == 0) {
+                if (ctx->zstream->avail_in == 0) {
                     if (ctx->flush == Z_NO_FLUSH) {
                         continue;
                     }
 
                 } else {
-                    ctx->crc32 = crc32(ctx->crc32, ctx->zstream.next_in,
-                                       ctx->zstream.avail_in);
+                    ctx->crc32 = crc32(ctx->crc32, ctx->zstream->next_in,
+                                       ctx->zstream->avail_in);
                 }
             }
 
 
             /* is there a space for the gzipped data ? */
 
-            if (ctx->zstream.avail_out == 0) {
+            if (ctx->zstream->avail_out == 0) {
 
                 if (ctx->free) {
-                    ctx->out_buf = ctx->free->buf;
-                    ctx->free = ctx->free->next;
+                    cl = ctx->free;
+                    ctx->out_buf = cl->buf;
+                    ctx->free = cl->next;
+                    ngx_free_chain(cl);
 
                 } else if (ctx->bufs < conf->bufs.num) {
                     ctx->out_buf = ngx_create_temp_buf(r->pool,
@@ -581,17 +918,40 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
 #if 0
                 ctx->blocked = 0;
 #endif
-                ctx->zstream.next_out = ctx->out_buf->pos;
-                ctx->zstream.avail_out = conf->bufs.size;
+                ctx->zstream->next_out = ctx->out_buf->pos;
+                ctx->zstream->avail_out = conf->bufs.size;
             }
 
             ngx_log_debug6(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                            "deflate in: ni:%X no:%X ai:%d ao:%d fl:%d redo:%d",
-                           ctx->zstream.next_in, ctx->zstream.next_out,
-                           ctx->zstream.avail_in, ctx->zstream.avail_out,
+                           ctx->zstream->next_in, ctx->zstream->next_out,
+                           ctx->zstream->avail_in, ctx->zstream->avail_out,
                            ctx->flush, ctx->redo);
 
-            rc = deflate(&ctx->zstream, ctx->flush);
+            p = ctx->zstream->next_out;
+
+#if (NGX_THREADS)
+
+            if (ngx_http_gzip_threads_n
+                && (ctx->length >= conf->thread_min_length
+                    || (off_t) ctx->zstream->total_in
+                                                 >= conf->thread_min_length))
+            {
+                if (ngx_http_gzip_thread_deflate(r, ctx, &rc) == NGX_AGAIN) {
+                    return ngx_http_gzip_thread_send(r, ctx);
+                }
+
+            } else {
+                rc = deflate(ctx->zstream, ctx->flush);
+            }
+
+deflated:
+
+#else
+
+            rc = deflate(ctx->zstream, ctx->flush);
+
+#endif
 
             if (rc != Z_OK && rc != Z_STREAM_END) {
                 ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
@@ -599,10 +959,14 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
                 return ngx_http_gzip_error(ctx);
             }
 
+            if (ctx->cache) {
+                ngx_http_gzip_cache_copy(ctx, p, ctx->zstream->next_out);
+            }
+
             ngx_log_debug5(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                            "deflate out: ni:%X no:%X ai:%d ao:%d rc:%d",
-                           ctx->zstream.next_in, ctx->zstream.next_out,
-                           ctx->zstream.avail_in, ctx->zstream.avail_out,
+                           ctx->zstream->next_in, ctx->zstream->next_out,
+                           ctx->zstream->avail_in, ctx->zstream->avail_out,
                            rc);
 
             ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
@@ -610,17 +974,17 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
                            ctx->in_buf, ctx->in_buf->pos);
 
 
-            if (ctx->zstream.next_in) {
-                ctx->in_buf->pos = ctx->zstream.next_in;
+            if (ctx->zstream->next_in) {
+                ctx->in_buf->pos = ctx->zstream->next_in;
 
-                if (ctx->zstream.avail_in == 0) {
-                    ctx->zstream.next_in = NULL;
+                if (ctx->zstream->avail_in == 0) {
+                    ctx->zstream->next_in = NULL;
                 }
             }
 
-            ctx->out_buf->last = ctx->zstream.next_out;
+            ctx->out_buf->last = ctx->zstream->next_out;
 
-            if (ctx->zstream.avail_out == 0) {
+            if (ctx->zstream->avail_out == 0) {
 
                 /* zlib wants to output some more gzipped data */
 
@@ -636,7 +1000,9 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
 
             ctx->redo = 0;
 
-            if (ctx->flush == Z_SYNC_FLUSH) {
+            /* the thread may deflate the flushed input in several chunks */
+
+            if (ctx->flush == Z_SYNC_FLUSH && ctx->zstream->avail_in == 0) {
 
                 ctx->out_buf->flush = 0;
                 ctx->flush = Z_NO_FLUSH;
@@ -655,25 +1021,15 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
 
             if (rc == Z_STREAM_END) {
 
-                ctx->zin = ctx->zstream.total_in;
-                ctx->zout = 10 + ctx->zstream.total_out + 8;
-
-                rc = deflateEnd(&ctx->zstream);
-
-                if (rc != Z_OK) {
-                    ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
-                                  "deflateEnd() failed: %d", rc);
-                    return ngx_http_gzip_error(ctx);
-                }
-
-                ngx_pfree(r->pool, ctx->preallocated);
+                ctx->zin = ctx->zstream->total_in;
+                ctx->zout = 10 + ctx->zstream->total_out + 8;
 
                 ngx_alloc_link_and_set_buf(cl, ctx->out_buf, r->pool,
                                            ngx_http_gzip_error(ctx));
                 *ctx->last_out = cl;
                 ctx->last_out = &cl->next;
 
-                if (ctx->zstream.avail_out >= 8) {
+                if (ctx->zstream->avail_out >= 8) {
                     trailer = (struct gztrailer *) ctx->out_buf->last;
                     ctx->out_buf->last += 8;
                     ctx->out_buf->last_buf = 1;
@@ -708,8 +1064,25 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
                 trailer->zlen[3] = (ctx->zin >> 24) & 0xff;
 #endif
 
-                ctx->zstream.avail_in = 0;
-                ctx->zstream.avail_out = 0;
+                if (ctx->cache) {
+                    p = (u_char *) trailer;
+                    ngx_http_gzip_cache_copy(ctx, p, p + 8);
+                }
+
+                if (ctx->cache) {
+                    size = ctx->cache_last - ctx->cache_start;
+                    ngx_http_gzip_cache_put(&ctx->key, ctx->cache_start, size);
+                }
+
+                if (ctx->cache_start) {
+                    ngx_pfree(r->pool, ctx->cache_start);
+                    ctx->cache_start = NULL;
+                }
+
+                /* the state is reset and is returned to the worker list */
+
+                ngx_http_gzip_put_state(ctx->state);
+                ctx->state = NULL;
 
                 ctx->done = 1;
 #if 0
@@ -800,7 +1173,7 @@ static ngx_int_t ngx_http_gzip_body_filter(ngx_http_request_t *r,
 
 static void *ngx_http_gzip_filter_alloc(void *opaque, u_int items, u_int size)
 {
-    ngx_http_gzip_ctx_t *ctx = opaque;
+    ngx_http_gzip_state_t *state = opaque;
 
     void        *p;
     ngx_uint_t   alloc;
@@ -815,28 +1188,30 @@ static void *ngx_http_gzip_filter_alloc(void *opaque, u_int items, u_int size)
         alloc = (alloc + ngx_pagesize - 1) & ~(ngx_pagesize - 1);
     }
 
-    if (alloc <= ctx->allocated) {
-        p = ctx->free_mem;
-        ctx->free_mem += alloc;
-        ctx->allocated -= alloc;
+    if (alloc <= state->allocated) {
+        p = state->free_mem;
+        state->free_mem += alloc;
+        state->allocated -= alloc;
 
-        ngx_log_debug4(NGX_LOG_DEBUG_HTTP, ctx->request->connection->log, 0,
+        ngx_log_debug4(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
                        "gzip alloc: n:%d s:%d a:%d p:" PTR_FMT,
                        items, size, alloc, p);
 
         return p;
     }
 
-    ngx_log_error(NGX_LOG_ALERT, ctx->request->connection->log, 0,
-                  "gzip filter failed to use preallocated memory: %d of %d",
-                  items * size, ctx->allocated);
+    /*
+     * the state outlives the request so the request pool can not be used,
+     * deflateInit2() fails in this case
+     */
 
-    p = ngx_palloc(ctx->request->pool, items * size);
+    ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                  "gzip filter failed to use preallocated memory: %d of %d",
+                  items * size, state->allocated);
 
-    return p;
+    return Z_NULL;
 }
 
-
 static void ngx_http_gzip_filter_free(void *opaque, void *address)
 {
 #if 0
@@ -848,23 +1223,763 @@ static void ngx_http_gzip_filter_free(void *opaque, void *address)
 }
 
 
-static u_char *ngx_http_gzip_log_ratio(ngx_http_request_t *r, u_char *buf,
-                                       uintptr_t data)
+static ngx_http_gzip_state_t *ngx_http_gzip_get_state(ngx_http_request_t *r,
+                                                      int level, int wbits,
+                                                      int memlevel)
 {
-    ngx_uint_t            zint, zfrac;
-    ngx_http_gzip_ctx_t  *ctx;
+    int                     rc;
+    size_t                  size;
+    ngx_http_gzip_state_t  *state, **sp;
 
-    ctx = ngx_http_get_module_ctx(r, ngx_http_gzip_filter_module);
+    for (sp = &ngx_http_gzip_states; *sp; sp = &(*sp)->next) {
+        state = *sp;
 
-    if (ctx == NULL || ctx->zout == 0) {
-        *buf = '-';
-        return buf + 1;
-    }
+        if (state->level == level
+            && state->wbits == wbits
+            && state->memlevel == memlevel)
+        {
+            *sp = state->next;
+            ngx_http_gzip_nstates--;
 
-#if 0
-    return buf + ngx_snprintf((char *) buf, NGX_INT32_LEN + 4, "%.2f",
-                              (float) ctx->zin / ctx->zout);
-#endif
+            ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                           "gzip reuse state: " PTR_FMT, state);
+
+            return state;
+        }
+    }
+
+    /*
+     * We preallocate a memory for zlib in one buffer (200K-400K), this
+     * dicreases a number of malloc() and free() calls and also probably
+     * dicreases a number of syscalls (sbrk() or so).
+     * The buffer lives with the state and is not freed after the response,
+     * so the next response with the same parameters only resets the state.
+     *
+     * 8K is for zlib deflate_state, it takes
+     *  * 5816 bytes on x86 and sparc64 (32-bit mode)
+     *  * 5920 bytes on amd64 and sparc64
+     */
+
+    size = 8192 + (1 << (wbits + 2)) + (1 << (memlevel + 9));
+
+    if (!(state = ngx_alloc(sizeof(ngx_http_gzip_state_t) + size,
+                            r->connection->log)))
+    {
+        return NULL;
+    }
+
+    ngx_memzero(&state->zstream, sizeof(z_stream));
+
+    state->next = NULL;
+    state->level = level;
+    state->wbits = wbits;
+    state->memlevel = memlevel;
+    state->free_mem = (char *) state + sizeof(ngx_http_gzip_state_t);
+    state->allocated = size;
+
+#if (NGX_THREADS)
+    state->request = NULL;
+    state->thread_in = NULL;
+    state->thread_out = NULL;
+#endif
+
+    state->zstream.zalloc = ngx_http_gzip_filter_alloc;
+    state->zstream.zfree = ngx_http_gzip_filter_free;
+    state->zstream.opaque = state;
+
+    rc = deflateInit2(&state->zstream, level, Z_DEFLATED,
+                      -wbits, memlevel, Z_DEFAULT_STRATEGY);
+
+    if (rc != Z_OK) {
+        ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
+                      "deflateInit2() failed: %d", rc);
+        ngx_free(state);
+        return NULL;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "gzip new state: " PTR_FMT, state);
+
+    return state;
+}
+
+
+static void ngx_http_gzip_put_state(ngx_http_gzip_state_t *state)
+{
+    int  rc;
+
+    if (ngx_http_gzip_nstates >= NGX_HTTP_GZIP_FREE_STATES) {
+        ngx_http_gzip_free_state(state);
+        return;
+    }
+
+    rc = deflateReset(&state->zstream);
+
+    if (rc != Z_OK) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, 0,
+                      "deflateReset() failed: %d", rc);
+        ngx_http_gzip_free_state(state);
+        return;
+    }
+
+    /* the buffers of the previous response must not be used */
+
+    state->zstream.next_in = NULL;
+    state->zstream.avail_in = 0;
+    state->zstream.next_out = NULL;
+    state->zstream.avail_out = 0;
+
+    state->next = ngx_http_gzip_states;
+    ngx_http_gzip_states = state;
+    ngx_http_gzip_nstates++;
+}
+
+
+static void ngx_http_gzip_free_state(ngx_http_gzip_state_t *state)
+{
+    /* zlib frees nothing, its memory is the part of the state */
+
+    deflateEnd(&state->zstream);
+
+#if (NGX_THREADS)
+    if (state->thread_in) {
+        ngx_free(state->thread_in);
+    }
+#endif
+
+    ngx_free(state);
+}
+
+
+/* the state of the response that has not been compressed completely */
+
+static void ngx_http_gzip_cleanup_state(void *data)
+{
+    ngx_http_gzip_ctx_t  *ctx = data;
+
+    if (ctx->state == NULL) {
+        return;
+    }
+
+#if (NGX_THREADS)
+
+    if (ctx->thread_busy) {
+
+        /* the state is freed by ngx_http_gzip_thread_handler() */
+
+        ctx->state->request = NULL;
+        ctx->state = NULL;
+
+        return;
+    }
+
+#endif
+
+    ngx_http_gzip_put_state(ctx->state);
+    ctx->state = NULL;
+}
+
+
+#if (NGX_THREADS)
+
+/*
+ * the large responses are deflated by the gzip threads: the input is copied
+ * to the state buffer, the thread deflates it to the other state buffer
+ * and returns the state through the pipe, then the worker copies the output
+ * to out_buf and posts the write event of the request, so the body filter
+ * continues from the same place and the output order is kept
+ */
+
+static ngx_int_t ngx_http_gzip_thread_deflate(ngx_http_request_t *r,
+                                              ngx_http_gzip_ctx_t *ctx,
+                                              int *rc)
+{
+    uInt                    size;
+    z_stream               *zs;
+    ngx_http_gzip_state_t  *state;
+
+    state = ctx->state;
+    zs = ctx->zstream;
+
+    if (state->thread_in == NULL) {
+        state->thread_in = ngx_alloc(2 * NGX_HTTP_GZIP_THREAD_CHUNK,
+                                     r->connection->log);
+
+        if (state->thread_in == NULL) {
+            *rc = deflate(zs, ctx->flush);
+            return NGX_OK;
+        }
+
+        state->thread_out = state->thread_in + NGX_HTTP_GZIP_THREAD_CHUNK;
+    }
+
+    state->next_in = zs->next_in;
+    state->avail_in = zs->avail_in;
+    state->next_out = zs->next_out;
+    state->avail_out = zs->avail_out;
+    state->flush = ctx->flush;
+
+    size = zs->avail_in;
+
+    if (size > NGX_HTTP_GZIP_THREAD_CHUNK) {
+        size = NGX_HTTP_GZIP_THREAD_CHUNK;
+
+        /* the rest of the input must be deflated before the flush */
+
+        state->flush = Z_NO_FLUSH;
+    }
+
+    if (size) {
+        ngx_memcpy(state->thread_in, zs->next_in, size);
+    }
+
+    zs->next_in = state->thread_in;
+    zs->avail_in = size;
+
+    size = zs->avail_out;
+
+    if (size > NGX_HTTP_GZIP_THREAD_CHUNK) {
+        size = NGX_HTTP_GZIP_THREAD_CHUNK;
+    }
+
+    zs->next_out = state->thread_out;
+    zs->avail_out = size;
+
+    state->request = r;
+
+    if (write(ngx_http_gzip_thread_tasks[1], &state,
+              sizeof(ngx_http_gzip_state_t *))
+        != sizeof(ngx_http_gzip_state_t *))
+    {
+        /* the task pipe is full, the worker deflates itself */
+
+        state->rc = deflate(zs, state->flush);
+        *rc = ngx_http_gzip_thread_result(ctx);
+
+        return NGX_OK;
+    }
+
+    ctx->thread_busy = 1;
+
+    return NGX_AGAIN;
+}
+
+
+/* the request buffers are restored as if deflate() had used them */
+
+static int ngx_http_gzip_thread_result(ngx_http_gzip_ctx_t *ctx)
+{
+    uInt                    in, out;
+    z_stream               *zs;
+    ngx_http_gzip_state_t  *state;
+
+    state = ctx->state;
+    zs = ctx->zstream;
+
+    in = (uInt) (zs->next_in - state->thread_in);
+    out = (uInt) (zs->next_out - state->thread_out);
+
+    if (out) {
+        ngx_memcpy(state->next_out, state->thread_out, out);
+    }
+
+    zs->next_in = state->next_in + in;
+    zs->avail_in = state->avail_in - in;
+    zs->next_out = state->next_out + out;
+    zs->avail_out = state->avail_out - out;
+
+    return state->rc;
+}
+
+
+/* the data deflated before are sent while the thread works */
+
+static ngx_int_t ngx_http_gzip_thread_send(ngx_http_request_t *r,
+                                           ngx_http_gzip_ctx_t *ctx)
+{
+    if (ctx->out == NULL) {
+        return ngx_http_gzip_thread_wait(r);
+    }
+
+    if (ngx_http_next_body_filter(r, ctx->out) == NGX_ERROR) {
+
+        /* the state is still used by the thread */
+
+        ctx->done = 1;
+        return NGX_ERROR;
+    }
+
+    ngx_chain_update_chains(&ctx->free, &ctx->busy, &ctx->out,
+                            (ngx_buf_tag_t) &ngx_http_gzip_filter_module);
+    ctx->last_out = &ctx->out;
+
+    return ngx_http_gzip_thread_wait(r);
+}
+
+
+/*
+ * the write event is posted by ngx_http_gzip_thread_handler(), so while
+ * the thread deflates the level-triggered write event is deleted and
+ * the event is marked as ready, otherwise ngx_http_writer() would re-arm it
+ * and select or poll would wake up the worker again and again;
+ * the send timer is kept and is set if there is none, so "send_timeout"
+ * still limits the wait and the exiting worker waits for the thread
+ */
+
+static ngx_int_t ngx_http_gzip_thread_wait(ngx_http_request_t *r)
+{
+    ngx_event_t               *wev;
+    ngx_http_core_loc_conf_t  *clcf;
+
+    wev = r->connection->write;
+
+    if ((ngx_event_flags & NGX_USE_LEVEL_EVENT) && wev->active) {
+        if (ngx_del_event(wev, NGX_WRITE_EVENT, 0) == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+    }
+
+    if (!wev->timer_set) {
+        clcf = ngx_http_get_module_loc_conf(r->main ? r->main : r,
+                                            ngx_http_core_module);
+        ngx_add_timer(wev, clcf->send_timeout);
+    }
+
+    wev->ready = 1;
+
+    return NGX_AGAIN;
+}
+
+
+static void *ngx_http_gzip_thread_cycle(void *data)
+{
+    ssize_t                 n;
+    sigset_t                set;
+    ngx_err_t               err;
+    ngx_http_gzip_state_t  *state;
+
+    /* the signals are handled by the worker */
+
+    sigfillset(&set);
+
+    err = ngx_thread_sigmask(SIG_BLOCK, &set, NULL);
+    if (err) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, err,
+                      ngx_thread_sigmask_n " failed");
+        return (void *) 1;
+    }
+
+    ngx_setthrtitle("gzip thread");
+
+    for ( ;; ) {
+        n = read(ngx_http_gzip_thread_tasks[0], &state,
+                 sizeof(ngx_http_gzip_state_t *));
+
+        if (n != sizeof(ngx_http_gzip_state_t *)) {
+            if (n == -1 && ngx_errno == NGX_EINTR) {
+                continue;
+            }
+
+            return (void *) 1;
+        }
+
+        state->rc = deflate(&state->zstream, state->flush);
+
+        while (write(ngx_http_gzip_thread_done[1], &state,
+                     sizeof(ngx_http_gzip_state_t *)) == -1)
+        {
+            if (ngx_errno != NGX_EINTR) {
+                return (void *) 1;
+            }
+        }
+    }
+}
+
+
+static void ngx_http_gzip_thread_handler(ngx_event_t *ev)
+{
+    ssize_t                 n;
+    ngx_err_t               err;
+    ngx_event_t            *wev;
+    ngx_connection_t       *c;
+    ngx_http_request_t     *r;
+    ngx_http_gzip_ctx_t    *ctx;
+    ngx_http_gzip_state_t  *state;
+
+    c = ev->data;
+
+    for ( ;; ) {
+        n = read(c->fd, &state, sizeof(ngx_http_gzip_state_t *));
+
+        if (n == -1) {
+            err = ngx_errno;
+
+            if (err == NGX_EAGAIN) {
+                return;
+            }
+
+            if (err == NGX_EINTR) {
+                continue;
+            }
+
+            ngx_log_error(NGX_LOG_ALERT, ev->log, err,
+                          "read() from gzip thread pipe failed");
+            return;
+        }
+
+        if (n != sizeof(ngx_http_gzip_state_t *)) {
+            ngx_log_error(NGX_LOG_ALERT, ev->log, 0,
+                          "read() from gzip thread pipe returned %d", n);
+            return;
+        }
+
+        r = state->request;
+
+        if (r == NULL) {
+            ngx_http_gzip_free_state(state);
+            continue;
+        }
+
+        ctx = ngx_http_get_module_ctx(r, ngx_http_gzip_filter_module);
+
+        ctx->thread_busy = 0;
+        ctx->thread_done = 1;
+
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "gzip thread done: %d", state->rc);
+
+        wev = r->connection->write;
+
+        if (ngx_mutex_lock(ngx_posted_events_mutex) == NGX_ERROR) {
+            return;
+        }
+
+        ngx_post_event(wev);
+
+        ngx_mutex_unlock(ngx_posted_events_mutex);
+    }
+}
+
+#endif
+
+
+static ngx_int_t ngx_http_gzip_send_cached(ngx_http_request_t *r,
+                                           ngx_http_gzip_ctx_t *ctx,
+                                           ngx_chain_t *in)
+{
+    ngx_buf_t    *b;
+    ngx_chain_t  *cl;
+
+    /* the original response is skipped */
+
+    for (cl = in; cl; cl = cl->next) {
+        cl->buf->pos = cl->buf->last;
+        cl->buf->file_pos = cl->buf->file_last;
+    }
+
+    if (ctx->cached == NULL) {
+        return ngx_http_next_body_filter(r, NULL);
+    }
+
+    b = ctx->cached;
+    ctx->cached = NULL;
+
+    if (!r->main) {
+        b->last_buf = 1;
+    }
+
+    ngx_alloc_link_and_set_buf(cl, b, r->pool, NGX_ERROR);
+
+    return ngx_http_next_body_filter(r, cl);
+}
+
+
+static void ngx_http_gzip_cache_copy(ngx_http_gzip_ctx_t *ctx, u_char *p,
+                                     u_char *last)
+{
+    if ((size_t) (last - p) > (size_t) (ctx->cache_end - ctx->cache_last)) {
+
+        /* it should not happen because of deflateBound() */
+
+        ngx_log_error(NGX_LOG_ALERT, ctx->request->connection->log, 0,
+                      "gzip cache copy is too small");
+        ctx->cache = 0;
+        return;
+    }
+
+    ctx->cache_last = ngx_cpymem(ctx->cache_last, p, (last - p));
+}
+
+
+static ngx_buf_t *ngx_http_gzip_cache_get(ngx_http_request_t *r,
+                                          ngx_http_gzip_cache_key_t *key)
+{
+    uint32_t                     hash;
+    ngx_buf_t                   *b;
+    ngx_http_gzip_cache_t       *cache;
+    ngx_http_gzip_cache_node_t  *node;
+
+    cache = ngx_http_gzip_cache_pool->data;
+    hash = ngx_crc_fast((u_char *) key, sizeof(ngx_http_gzip_cache_key_t));
+
+    ngx_slab_lock(ngx_http_gzip_cache_pool);
+
+    node = ngx_http_gzip_cache_lookup(cache, key, hash);
+
+    if (node == NULL) {
+        cache->stat.misses++;
+        ngx_slab_unlock(ngx_http_gzip_cache_pool);
+        return NULL;
+    }
+
+    /* move the entry to the head of the LRU list */
+
+    node->lru_prev->lru_next = node->lru_next;
+    node->lru_next->lru_prev = node->lru_prev;
+
+    node->lru_prev = &cache->lru;
+    node->lru_next = cache->lru.lru_next;
+    node->lru_next->lru_prev = node;
+    cache->lru.lru_next = node;
+
+    /* the entry may be evicted by other worker so it is copied */
+
+    b = ngx_create_temp_buf(r->pool, node->len);
+
+    if (b == NULL) {
+        ngx_slab_unlock(ngx_http_gzip_cache_pool);
+        return NULL;
+    }
+
+    b->last = ngx_cpymem(b->pos, node->data, node->len);
+
+    cache->stat.hits++;
+
+    ngx_slab_unlock(ngx_http_gzip_cache_pool);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "gzip cache hit: " PTR_FMT " %d", node, node->len);
+
+    return b;
+}
+
+
+static void ngx_http_gzip_cache_put(ngx_http_gzip_cache_key_t *key,
+                                    u_char *data, size_t len)
+{
+    uint32_t                     hash;
+    ngx_http_gzip_cache_t       *cache;
+    ngx_http_gzip_cache_node_t  *node, **bucket;
+
+    cache = ngx_http_gzip_cache_pool->data;
+
+    if (len > cache->max_size) {
+        return;
+    }
+
+    hash = ngx_crc_fast((u_char *) key, sizeof(ngx_http_gzip_cache_key_t));
+
+    ngx_slab_lock(ngx_http_gzip_cache_pool);
+
+    /* the same file may be compressed by other worker at the same time */
+
+    if (ngx_http_gzip_cache_lookup(cache, key, hash)) {
+        ngx_slab_unlock(ngx_http_gzip_cache_pool);
+        return;
+    }
+
+    for ( ;; ) {
+        node = ngx_slab_alloc_locked(ngx_http_gzip_cache_pool,
+                                     sizeof(ngx_http_gzip_cache_node_t));
+
+        if (node) {
+            node->data = ngx_slab_alloc_locked(ngx_http_gzip_cache_pool, len);
+
+            if (node->data) {
+                break;
+            }
+
+            ngx_slab_free_locked(ngx_http_gzip_cache_pool, node);
+        }
+
+        if (cache->lru.lru_prev == &cache->lru) {
+            ngx_slab_unlock(ngx_http_gzip_cache_pool);
+            return;
+        }
+
+        ngx_http_gzip_cache_evict(cache);
+    }
+
+    ngx_memcpy(node->data, data, len);
+
+    node->hash = hash;
+    node->key = *key;
+    node->len = len;
+
+    bucket = &cache->buckets[hash % cache->nbuckets];
+    node->next = *bucket;
+    *bucket = node;
+
+    node->lru_prev = &cache->lru;
+    node->lru_next = cache->lru.lru_next;
+    node->lru_next->lru_prev = node;
+    cache->lru.lru_next = node;
+
+    cache->stat.entries++;
+    cache->stat.stores++;
+
+    ngx_slab_unlock(ngx_http_gzip_cache_pool);
+}
+
+
+static ngx_http_gzip_cache_node_t *ngx_http_gzip_cache_lookup(
+    ngx_http_gzip_cache_t *cache, ngx_http_gzip_cache_key_t *key,
+    uint32_t hash)
+{
+    ngx_http_gzip_cache_node_t  *node;
+
+    node = cache->buckets[hash % cache->nbuckets];
+
+    for ( /* void */ ; node; node = node->next) {
+        if (node->hash == hash
+            && ngx_memcmp(&node->key, key, sizeof(ngx_http_gzip_cache_key_t))
+                                                                          == 0)
+        {
+            return node;
+        }
+    }
+
+    return NULL;
+}
+
+
+/* evicts the least recently used entry, the zone must be locked */
+
+static void ngx_http_gzip_cache_evict(ngx_http_gzip_cache_t *cache)
+{
+    ngx_http_gzip_cache_node_t  *node, **np;
+
+    node = cache->lru.lru_prev;
+
+    node->lru_prev->lru_next = &cache->lru;
+    cache->lru.lru_prev = node->lru_prev;
+
+    for (np = &cache->buckets[node->hash % cache->nbuckets];
+         *np != node;
+         np = &(*np)->next)
+    {
+        /* void */
+    }
+
+    *np = node->next;
+
+    ngx_slab_free_locked(ngx_http_gzip_cache_pool, node->data);
+    ngx_slab_free_locked(ngx_http_gzip_cache_pool, node);
+
+    cache->stat.entries--;
+    cache->stat.evictions++;
+}
+
+
+/*
+ * the level is lowered by one a second down to "gzip_comp_level_min"
+ * while the event loop lags or the worker is busy and it is raised back
+ * the same way when the load drops to the half of the lag and to the 3/4
+ * of the CPU; the already started responses keep their levels
+ */
+
+static int ngx_http_gzip_level(ngx_http_gzip_conf_t *conf)
+{
+    int  level;
+
+    if (ngx_http_gzip_adaptive_lag == 0 || conf->level_min >= conf->level) {
+        return conf->level;
+    }
+
+    ngx_http_gzip_adapt();
+
+    level = conf->level - (int) ngx_http_gzip_level_stat.lowered;
+
+    if (level < conf->level_min) {
+        level = (int) conf->level_min;
+    }
+
+    ngx_http_gzip_level_stat.level = level;
+
+    return level;
+}
+
+
+static void ngx_http_gzip_adapt()
+{
+    ngx_msec_t        wall;
+    ngx_uint_t        cpu;
+    struct rusage     ru;
+    ngx_epoch_msec_t  used;
+
+    wall = (ngx_msec_t) (ngx_elapsed_msec - ngx_http_gzip_adapt_time);
+
+    if (wall < 1000) {
+        return;
+    }
+
+    if (getrusage(RUSAGE_SELF, &ru) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "getrusage() failed");
+        return;
+    }
+
+    /* the gzip threads are counted too */
+
+    used = (ngx_epoch_msec_t) (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000
+           + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000;
+
+    cpu = (ngx_uint_t) ((used - ngx_http_gzip_adapt_used) * 100 / wall);
+
+    ngx_http_gzip_adapt_time = ngx_elapsed_msec;
+    ngx_http_gzip_adapt_used = used;
+
+    if (ngx_event_lag >= ngx_http_gzip_adaptive_lag
+        || cpu >= ngx_http_gzip_adaptive_cpu)
+    {
+        if (ngx_http_gzip_level_stat.lowered < 8) {
+            ngx_http_gzip_level_stat.lowered++;
+        }
+
+    } else if (ngx_event_lag < ngx_http_gzip_adaptive_lag / 2
+               && cpu < ngx_http_gzip_adaptive_cpu * 3 / 4)
+    {
+        if (ngx_http_gzip_level_stat.lowered) {
+            ngx_http_gzip_level_stat.lowered--;
+        }
+    }
+
+    ngx_http_gzip_level_stat.lag = ngx_event_lag;
+    ngx_http_gzip_level_stat.cpu = cpu;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, ngx_cycle->log, 0,
+                   "gzip adapt lag:%d cpu:%d lowered:%d",
+                   ngx_event_lag, cpu, ngx_http_gzip_level_stat.lowered);
+}
+
+
+static u_char *ngx_http_gzip_log_ratio(ngx_http_request_t *r, u_char *buf,
+                                       uintptr_t data)
+{
+    ngx_uint_t            zint, zfrac;
+    ngx_http_gzip_ctx_t  *ctx;
+
+    ctx = ngx_http_get_module_ctx(r, ngx_http_gzip_filter_module);
+
+    if (ctx == NULL || ctx->zout == 0) {
+        *buf = '-';
+        return buf + 1;
+    }
+
+#if 0
+    return buf + ngx_snprintf((char *) buf, NGX_INT32_LEN + 4, "%.2f",
+                              (float) ctx->zin / ctx->zout);
+#endif
 
     /* we prefer do not use FPU */
 
@@ -886,12 +2001,28 @@ static u_char *ngx_http_gzip_log_ratio(ngx_http_request_t *r, u_char *buf,
 
 ngx_inline static int ngx_http_gzip_error(ngx_http_gzip_ctx_t *ctx)
 {
-    deflateEnd(&ctx->zstream);
+    /* the state may be inconsistent so it is not reused */
+
+    if (ctx->state) {
+
+#if (NGX_THREADS)
+
+        if (ctx->thread_busy) {
+
+            /* the state is freed by ngx_http_gzip_thread_handler() */
 
-    ngx_pfree(ctx->request->pool, ctx->preallocated);
+            ctx->state->request = NULL;
+            ctx->state = NULL;
+            ctx->done = 1;
 
-    ctx->zstream.avail_in = 0;
-    ctx->zstream.avail_out = 0;
+            return NGX_ERROR;
+        }
+
+#endif
+
+        ngx_http_gzip_free_state(ctx->state);
+        ctx->state = NULL;
+    }
 
     ctx->done = 1;
 
@@ -916,6 +2047,11 @@ static ngx_int_t ngx_http_gzip_pre_conf(ngx_conf_t *cf)
 
     op->op = (ngx_http_log_op_pt) ngx_http_gzip_log_fmt_ops;
 
+    /* "gzip_adaptive" does not survive the reconfiguration without it */
+
+    ngx_http_gzip_adaptive_lag = 0;
+    ngx_event_lag_enabled = 0;
+
     return NGX_OK;
 }
 
@@ -951,13 +2087,16 @@ static void *ngx_http_gzip_create_conf(ngx_conf_t *cf)
 
     conf->enable = NGX_CONF_UNSET;
     conf->no_buffer = NGX_CONF_UNSET;
+    conf->cache = NGX_CONF_UNSET;
 
     conf->http_version = NGX_CONF_UNSET_UINT;
 
     conf->level = NGX_CONF_UNSET;
+    conf->level_min = NGX_CONF_UNSET;
     conf->wbits = (size_t) NGX_CONF_UNSET;
     conf->memlevel = (size_t) NGX_CONF_UNSET;
     conf->min_length = NGX_CONF_UNSET;
+    conf->thread_min_length = NGX_CONF_UNSET;
 
     return conf;
 }
@@ -980,11 +2119,20 @@ static char *ngx_http_gzip_merge_conf(ngx_conf_t *cf,
                                   |NGX_HTTP_GZIP_PROXIED_OFF));
 
     ngx_conf_merge_value(conf->level, prev->level, 1);
+    ngx_conf_merge_value(conf->level_min, prev->level_min, conf->level);
+
+    if (conf->level_min > conf->level) {
+        conf->level_min = conf->level;
+    }
+
     ngx_conf_merge_size_value(conf->wbits, prev->wbits, MAX_WBITS);
     ngx_conf_merge_size_value(conf->memlevel, prev->memlevel,
                               MAX_MEM_LEVEL - 1);
     ngx_conf_merge_value(conf->min_length, prev->min_length, 0);
+    ngx_conf_merge_value(conf->thread_min_length, prev->thread_min_length,
+                         1024 * 1024);
     ngx_conf_merge_value(conf->no_buffer, prev->no_buffer, 0);
+    ngx_conf_merge_value(conf->cache, prev->cache, 0);
 
     return NGX_CONF_OK;
 }
@@ -1034,3 +2182,182 @@ static char *ngx_http_gzip_set_hash(ngx_conf_t *cf, void *post, void *data)
 
     return "must be 512, 1k, 2k, 4k, 8k, 16k, 32k, 64k, or 128k";
 }
+
+
+static char *ngx_http_gzip_set_cache_zone(ngx_conf_t *cf, ngx_command_t *cmd,
+                                          void *conf)
+{
+    ssize_t                 size;
+    ngx_str_t              *value;
+    ngx_http_gzip_cache_t  *cache;
+
+    if (ngx_http_gzip_cache_pool && ngx_http_gzip_cache_cycle == cf->cycle) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    size = ngx_parse_size(&value[1]);
+    if (size == NGX_ERROR) {
+        return "invalid value";
+    }
+
+    /* the zone has at least one bucket and the room for the slab pages */
+
+    if (size < NGX_HTTP_GZIP_CACHE_MIN_SIZE) {
+        return "must be at least 64k";
+    }
+
+    ngx_http_gzip_cache_cycle = cf->cycle;
+
+    /* the zone of the same size and its entries survive the reconfiguration */
+
+    if (ngx_http_gzip_cache_pool
+        && ngx_http_gzip_cache_pool->end - (u_char *) ngx_http_gzip_cache_pool
+                                                                      == size)
+    {
+        return NGX_CONF_OK;
+    }
+
+    ngx_http_gzip_cache_pool = ngx_slab_create(size, cf->log);
+    if (ngx_http_gzip_cache_pool == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    /* the exhausted zone is the normal case, the entries are evicted */
+
+    ngx_http_gzip_cache_pool->log_nomem = 0;
+
+    cache = ngx_slab_calloc(ngx_http_gzip_cache_pool,
+                            sizeof(ngx_http_gzip_cache_t));
+    if (cache == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    /* about one bucket for the 8K compressed file */
+
+    cache->nbuckets = size / 8192;
+    cache->max_size = size / 8;
+
+    cache->buckets = ngx_slab_calloc(ngx_http_gzip_cache_pool,
+                                     cache->nbuckets
+                                     * sizeof(ngx_http_gzip_cache_node_t *));
+    if (cache->buckets == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    cache->lru.lru_prev = &cache->lru;
+    cache->lru.lru_next = &cache->lru;
+
+    ngx_http_gzip_cache_pool->data = cache;
+    ngx_http_gzip_cache_stat = &cache->stat;
+
+    return NGX_CONF_OK;
+}
+
+
+static char *ngx_http_gzip_set_adaptive(ngx_conf_t *cf, ngx_command_t *cmd,
+                                        void *conf)
+{
+    ngx_int_t   lag, cpu;
+    ngx_str_t  *value;
+
+    value = cf->args->elts;
+
+    lag = ngx_parse_time(&value[1], 0);
+    if (lag == NGX_ERROR || lag == NGX_PARSE_LARGE_TIME || lag == 0) {
+        return "invalid lag value";
+    }
+
+    cpu = ngx_atoi(value[2].data, value[2].len);
+    if (cpu == NGX_ERROR || cpu == 0) {
+        return "invalid cpu value";
+    }
+
+    ngx_http_gzip_adaptive_lag = (ngx_msec_t) lag;
+    ngx_http_gzip_adaptive_cpu = (ngx_uint_t) cpu;
+
+    /* the event loop lag is measured only for "gzip_adaptive" */
+
+    ngx_event_lag_enabled = 1;
+
+    return NGX_CONF_OK;
+}
+
+
+#if (NGX_THREADS)
+
+static ngx_int_t ngx_http_gzip_init_process(ngx_cycle_t *cycle)
+{
+    ngx_int_t         i;
+    ngx_tid_t         tid;
+    ngx_core_conf_t  *ccf;
+
+    if (ngx_http_gzip_threads_n == 0) {
+        return NGX_OK;
+    }
+
+    if (pipe(ngx_http_gzip_thread_tasks) == -1
+        || pipe(ngx_http_gzip_thread_done) == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno, "pipe() failed");
+        return NGX_ERROR;
+    }
+
+    /* the worker never blocks on the pipes, the threads always block */
+
+    if (ngx_nonblocking(ngx_http_gzip_thread_tasks[1]) == -1
+        || ngx_nonblocking(ngx_http_gzip_thread_done[0]) == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      ngx_nonblocking_n " failed");
+        return NGX_ERROR;
+    }
+
+    if (ngx_add_channel_event(cycle, ngx_http_gzip_thread_done[0],
+                              NGX_READ_EVENT, ngx_http_gzip_thread_handler)
+                                                                  == NGX_ERROR)
+    {
+        return NGX_ERROR;
+    }
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    if (ngx_init_threads(ngx_http_gzip_threads_n, ccf->thread_stack_size,
+                         cycle) == NGX_ERROR)
+    {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < ngx_http_gzip_threads_n; i++) {
+        if (ngx_create_thread(&tid, ngx_http_gzip_thread_cycle, NULL,
+                              cycle->log) != 0)
+        {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static char *ngx_http_gzip_set_threads(ngx_conf_t *cf, ngx_command_t *cmd,
+                                       void *conf)
+{
+    ngx_int_t   n;
+    ngx_str_t  *value;
+
+    value = cf->args->elts;
+
+    n = ngx_atoi(value[1].data, value[1].len);
+
+    if (n == NGX_ERROR || n > NGX_MAX_THREADS) {
+        return "invalid value";
+    }
+
+    ngx_http_gzip_threads_n = n;
+
+    return NGX_CONF_OK;
+}
+
+#endif
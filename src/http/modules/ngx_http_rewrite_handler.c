@@ -38,6 +38,7 @@ typedef struct {
 
 typedef struct {
     ngx_array_t   rules;
+    ngx_uint_t    msize;
     ngx_flag_t    log;
 } ngx_http_rewrite_srv_conf_t;
 
@@ -129,18 +130,20 @@ static ngx_int_t ngx_http_rewrite_handler(ngx_http_request_t *r)
 
     scf = ngx_http_get_module_srv_conf(r, ngx_http_rewrite_module);
 
-    rule = scf->rules.elts;
-    for (i = 0; i < scf->rules.nelts; i++) {
+    /* the captures vector is shared by all rules */
 
-        if (rule[i].msize) {
-            if (!(matches = ngx_palloc(r->pool, rule[i].msize * sizeof(int)))) {
-                return NGX_HTTP_INTERNAL_SERVER_ERROR;
-            }
-
-        } else {
-            matches = NULL;
+    if (scf->msize) {
+        if (!(matches = ngx_palloc(r->pool, scf->msize * sizeof(int)))) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
         }
 
+    } else {
+        matches = NULL;
+    }
+
+    rule = scf->rules.elts;
+    for (i = 0; i < scf->rules.nelts; i++) {
+
         rc = ngx_regex_exec(rule[i].regex, &r->uri, matches, rule[i].msize);
 
         if (rc == NGX_DECLINED) {
@@ -273,6 +276,7 @@ static void *ngx_http_rewrite_create_srv_conf(ngx_conf_t *cf)
     ngx_init_array(conf->rules, cf->pool, 5, sizeof(ngx_http_rewrite_rule_t),
                    NGX_CONF_ERROR);
 
+    conf->msize = 0;
     conf->log = NGX_CONF_UNSET;
 
     return conf;
@@ -419,6 +423,10 @@ static char *ngx_http_rewrite_rule(ngx_conf_t *cf, ngx_command_t *cmd,
         if (rule->msize) {
             rule->msize++;
             rule->msize *= 3;
+
+            if (scf->msize < rule->msize) {
+                scf->msize = rule->msize;
+            }
         }
 
         if (cf->args->nelts > 3) {
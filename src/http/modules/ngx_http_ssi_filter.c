@@ -221,6 +221,27 @@ static int ngx_http_ssi_body_filter(ngx_http_request_t *r, ngx_chain_t *in)
 
     while (ctx->in) {
         if (ctx->buf == NULL) {
+
+            /*
+             * the hunk without any '<' outside a command is passed as is,
+             * it is not copied and does not need the shadow hunk
+             */
+
+            if (ctx->saved == 0
+                && ctx->state == ssi_start_state
+                && ngx_strlchr(ctx->in->hunk->pos, ctx->in->hunk->last, '<')
+                                                                      == NULL)
+            {
+                cl = ctx->in;
+                ctx->in = cl->next;
+                cl->next = NULL;
+
+                *ctx->last_out = cl;
+                ctx->last_out = &cl->next;
+
+                continue;
+            }
+
             ctx->buf = ctx->in->hunk;
             ctx->in = ctx->in->next;
 
@@ -539,27 +560,25 @@ static ngx_int_t ngx_http_ssi_parse(ngx_http_request_t *r,
 
         case ssi_start_state:
 
-            /* a tight loop */
+            /* the vectorized scan to the next '<' */
 
-            for ( ;; ) {
+            if (ch != '<') {
+                p = (char *) ngx_strlchr((u_char *) p, (u_char *) end, '<');
 
-                if (ch == '<') {
-                    last = p - 1;
-                    state = ssi_tag_state;
-                    break;
-                }
-
-                if (p == end) {
-                    ctx->last = p;
-                    ctx->pos = p;
+                if (p == NULL) {
+                    ctx->last = end;
+                    ctx->pos = end;
                     ctx->state = ssi_start_state;
 
                     return NGX_HTTP_SSI_COPY;
                 }
 
-                ch = *p++;
+                p++;
             }
 
+            last = p - 1;
+            state = ssi_tag_state;
+
             break;
 
         case ssi_tag_state:
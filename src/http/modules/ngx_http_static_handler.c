@@ -10,11 +10,14 @@
 
 
 typedef struct {
+    ngx_flag_t              gzip_static;
     ngx_http_cache_hash_t  *redirect_cache;
 } ngx_http_static_loc_conf_t;
 
 
 static ngx_int_t ngx_http_static_handler(ngx_http_request_t *r);
+static ngx_int_t ngx_http_static_send_gzip(ngx_http_request_t *r,
+                                           ngx_str_t *name);
 static void *ngx_http_static_create_loc_conf(ngx_conf_t *cf);
 static char *ngx_http_static_merge_loc_conf(ngx_conf_t *cf,
                                             void *parent, void *child);
@@ -23,6 +26,13 @@ static ngx_int_t ngx_http_static_init(ngx_cycle_t *cycle);
 
 static ngx_command_t  ngx_http_static_commands[] = {
 
+    { ngx_string("gzip_static"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_static_loc_conf_t, gzip_static),
+      NULL },
+
 #if (NGX_HTTP_CACHE)
 
     { ngx_string("redirect_cache"),
@@ -169,6 +179,16 @@ static ngx_int_t ngx_http_static_handler(ngx_http_request_t *r)
     ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
                    "http filename: \"%s\"", name.data);
 
+    slcf = ngx_http_get_module_loc_conf(r, ngx_http_static_module);
+
+    if (slcf->gzip_static) {
+        rc = ngx_http_static_send_gzip(r, &name);
+
+        if (rc != NGX_DECLINED) {
+            return rc;
+        }
+    }
+
 
     /* allocate cleanups */
 
@@ -177,7 +197,6 @@ static ngx_int_t ngx_http_static_handler(ngx_http_request_t *r)
     }
     file_cleanup->valid = 0;
 
-    slcf = ngx_http_get_module_loc_conf(r, ngx_http_static_module);
     if (slcf->redirect_cache) {
         if (!(redirect_cleanup = ngx_push_array(&r->cleanup))) {
             return NGX_HTTP_INTERNAL_SERVER_ERROR;
@@ -486,6 +505,7 @@ static ngx_int_t ngx_http_static_handler(ngx_http_request_t *r)
     r->headers_out.status = NGX_HTTP_OK;
     r->headers_out.content_length_n = ngx_file_size(&fi);
     r->headers_out.last_modified_time = ngx_file_mtime(&fi);
+    r->headers_out.file_uniq = ngx_file_uniq(&fi);
 
     if (r->headers_out.content_length_n == 0) {
         r->header_only = 1;
@@ -538,6 +558,147 @@ static ngx_int_t ngx_http_static_handler(ngx_http_request_t *r)
 }
 
 
+/*
+ * the precompressed "file.gz" is sent as is if the client passes the gzip
+ * filter checks and the file is not older than the original one, otherwise
+ * NGX_DECLINED is returned and the original file is sent and probably
+ * compressed by the gzip filter
+ */
+
+static ngx_int_t ngx_http_static_send_gzip(ngx_http_request_t *r,
+                                           ngx_str_t *name)
+{
+    u_char              *last;
+    ngx_fd_t             fd;
+    ngx_int_t            rc;
+    ngx_str_t            gz;
+    ngx_log_t           *log;
+    ngx_buf_t           *b;
+    ngx_chain_t          out;
+    ngx_file_info_t      fi, gzfi;
+    ngx_http_cleanup_t  *cleanup;
+    ngx_http_log_ctx_t  *ctx;
+
+    if (ngx_http_gzip_ok(r) != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+    log = r->connection->log;
+
+    gz.len = name->len + sizeof(".gz") - 1;
+
+    if (!(gz.data = ngx_palloc(r->pool, gz.len + 1))) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    last = ngx_cpymem(gz.data, name->data, name->len);
+    ngx_cpystrn(last, (u_char *) ".gz", sizeof(".gz"));
+
+    fd = ngx_open_file(gz.data, NGX_FILE_RDONLY, NGX_FILE_OPEN);
+
+    if (fd == NGX_INVALID_FILE) {
+        /* there is no precompressed file, it is not an error */
+        return NGX_DECLINED;
+    }
+
+    if (ngx_fd_info(fd, &gzfi) == NGX_FILE_ERROR
+        || !ngx_is_file(&gzfi)
+        || ngx_file_info(name->data, &fi) == NGX_FILE_ERROR
+        || !ngx_is_file(&fi)
+        || ngx_file_mtime(&gzfi) < ngx_file_mtime(&fi))
+    {
+        ngx_log_debug1(NGX_LOG_DEBUG_HTTP, log, 0,
+                       "http static gzip: \"%s\" is not used", gz.data);
+
+        if (ngx_close_file(fd) == NGX_FILE_ERROR) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          ngx_close_file_n " \"%s\" failed", gz.data);
+        }
+
+        return NGX_DECLINED;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, log, 0,
+                   "http static gzip: \"%s\" fd: %d", gz.data, fd);
+
+    if (!(cleanup = ngx_push_array(&r->cleanup))) {
+        ngx_close_file(fd);
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    cleanup->data.file.fd = fd;
+    cleanup->data.file.name = gz.data;
+    cleanup->valid = 1;
+    cleanup->cache = 0;
+
+    ctx = log->data;
+    ctx->action = "sending response to client";
+
+    r->headers_out.status = NGX_HTTP_OK;
+    r->headers_out.content_length_n = ngx_file_size(&gzfi);
+    r->headers_out.last_modified_time = ngx_file_mtime(&fi);
+
+    if (r->headers_out.content_length_n == 0) {
+        r->header_only = 1;
+    }
+
+    r->headers_out.content_encoding = ngx_list_push(&r->headers_out.headers);
+    if (r->headers_out.content_encoding == NULL) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+    r->headers_out.content_encoding->key.len = sizeof("Content-Encoding") - 1;
+    r->headers_out.content_encoding->key.data = (u_char *) "Content-Encoding";
+    r->headers_out.content_encoding->value.len = sizeof("gzip") - 1;
+    r->headers_out.content_encoding->value.data = (u_char *) "gzip";
+
+    /* the type is set by the original file extension in r->exten */
+
+    if (ngx_http_set_content_type(r) != NGX_OK) {
+        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    }
+
+#if (NGX_SUPPRESS_WARN)
+    b = NULL;
+#endif
+
+    if (!r->header_only) {
+        if (!(b = ngx_pcalloc(r->pool, sizeof(ngx_buf_t)))) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        if (!(b->file = ngx_pcalloc(r->pool, sizeof(ngx_file_t)))) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        r->filter_allow_ranges = 1;
+    }
+
+    rc = ngx_http_send_header(r);
+
+    if (rc == NGX_ERROR || rc > NGX_OK || r->header_only) {
+        return rc;
+    }
+
+    b->in_file = 1;
+
+    if (!r->main) {
+        b->last_buf = 1;
+    }
+
+    b->file_pos = 0;
+    b->file_last = ngx_file_size(&gzfi);
+
+    b->file->fd = fd;
+    b->file->log = log;
+
+    out.buf = b;
+    out.next = NULL;
+
+    return ngx_http_output_filter(r, &out);
+}
+
+
 static void *ngx_http_static_create_loc_conf(ngx_conf_t *cf)
 {
     ngx_http_static_loc_conf_t  *conf;
@@ -546,6 +707,7 @@ static void *ngx_http_static_create_loc_conf(ngx_conf_t *cf)
         return NGX_CONF_ERROR;
     }
 
+    conf->gzip_static = NGX_CONF_UNSET;
     conf->redirect_cache = NULL;
 
     return conf;
@@ -558,6 +720,8 @@ static char *ngx_http_static_merge_loc_conf(ngx_conf_t *cf,
     ngx_http_static_loc_conf_t  *prev = parent;
     ngx_http_static_loc_conf_t  *conf = child;
 
+    ngx_conf_merge_value(conf->gzip_static, prev->gzip_static, 0);
+
     if (conf->redirect_cache == NULL) {
         conf->redirect_cache = prev->redirect_cache;
     }
@@ -22,6 +22,19 @@ static ngx_int_t ngx_http_status(ngx_http_status_ctx_t *ctx);
 static char *ngx_http_set_status(ngx_conf_t *cf, ngx_command_t *cmd,
                                  void *conf);
 
+#if (NGX_POOL_STAT)
+
+static char  *ngx_http_status_phases[] = {
+    "rewrite",
+    "find-config",
+    "access",
+    "content",
+    "filter"
+};
+
+#endif
+
+
 static ngx_command_t  ngx_http_status_commands[] = {
 
     { ngx_string("status"),
@@ -131,6 +144,13 @@ static ngx_int_t ngx_http_status(ngx_http_status_ctx_t *ctx)
     ngx_connection_t           *c;
     ngx_http_request_t         *r;
     ngx_http_core_main_conf_t  *cmcf;
+#if (NGX_POOL_STAT)
+    u_char                     *file, *last, *p;
+    char                       *phase;
+#endif
+#if (HAVE_PCRE && NGX_REGEX_STAT)
+    ngx_regex_t                *re;
+#endif
 
     cmcf = ngx_http_get_module_main_conf(ctx->request, ngx_http_core_module);
 
@@ -295,6 +315,255 @@ static ngx_int_t ngx_http_status(ngx_http_status_ctx_t *ctx)
         ctx->size += b->last - b->pos;
     }
 
+#if (NGX_POOL_STAT)
+
+    /* the pool allocations of this worker by module and phase */
+
+    for (i = 0; i < NGX_POOL_STAT_SLOTS; i++) {
+
+        if (ngx_pool_stat[i].file == NULL) {
+            continue;
+        }
+
+        file = (u_char *) ngx_pool_stat[i].file;
+        last = file + ngx_strlen(file);
+
+        for (p = last; p > file; p--) {
+            if (*(p - 1) == '/') {
+                break;
+            }
+        }
+
+        if (last - p > 2 && *(last - 2) == '.' && *(last - 1) == 'c') {
+            last -= 2;
+        }
+
+        len = NGX_INT64_LEN                           /* pid */
+              + 1 + (last - p)                        /* module */
+              + 1 + sizeof("find-config") - 1         /* phase */
+              + 3 * (1 + NGX_INT64_LEN)               /* counters */
+              + 2;                                    /* "\r\n" */
+
+        if (!(b = ngx_create_temp_buf(ctx->pool, len))) {
+            return NGX_ERROR;
+        }
+
+        b->last += ngx_snprintf((char *) b->last,
+                                /* STUB: should be NGX_PID_T_LEN */
+                                NGX_INT64_LEN + 1,
+                                PID_T_FMT " ", ngx_pid);
+
+        b->last = ngx_cpymem(b->last, p, (last - p));
+
+        if (ngx_pool_stat[i].phase == 0
+            || ngx_pool_stat[i].phase > NGX_HTTP_LAST_PHASE + 1)
+        {
+            phase = "-";
+
+        } else {
+            phase = ngx_http_status_phases[ngx_pool_stat[i].phase - 1];
+        }
+
+        b->last += ngx_snprintf((char *) b->last,
+                                1 + sizeof("find-config") - 1
+                                + 3 * (1 + NGX_INT64_LEN) + 1,
+                                " %s %u %u %u",
+                                phase, ngx_pool_stat[i].allocs,
+                                ngx_pool_stat[i].small,
+                                ngx_pool_stat[i].large);
+
+        *(b->last++) = CR; *(b->last++) = LF;
+
+        if (!(cl = ngx_alloc_chain_link(ctx->pool))) {
+            return NGX_ERROR;
+        }
+
+        if (ctx->head) {
+            *ll = cl;
+
+        } else {
+            ctx->head = cl;
+        }
+
+        cl->buf = b;
+        cl->next = NULL;
+        ll = &cl->next;
+
+        ctx->size += b->last - b->pos;
+    }
+
+#endif
+
+#if (HAVE_PCRE && NGX_REGEX_STAT)
+
+    /* the regexes of this worker: execs, skipped by prefix, matches, usec */
+
+    for (re = ngx_regexes; re; re = re->next) {
+
+        len = NGX_INT64_LEN                           /* pid */
+              + 4 * (1 + NGX_INT64_LEN)               /* counters */
+              + 1 + re->pattern.len                   /* pattern */
+              + 2;                                    /* "\r\n" */
+
+        if (!(b = ngx_create_temp_buf(ctx->pool, len))) {
+            return NGX_ERROR;
+        }
+
+        b->last += ngx_snprintf((char *) b->last,
+                                /* STUB: should be NGX_PID_T_LEN */
+                                NGX_INT64_LEN + 4 * (1 + NGX_INT64_LEN) + 2,
+                                PID_T_FMT " %u %u %u %u ",
+                                ngx_pid, re->execs, re->skips, re->matches,
+                                re->usec);
+
+        b->last = ngx_cpymem(b->last, re->pattern.data, re->pattern.len);
+
+        *(b->last++) = CR; *(b->last++) = LF;
+
+        if (!(cl = ngx_alloc_chain_link(ctx->pool))) {
+            return NGX_ERROR;
+        }
+
+        if (ctx->head) {
+            *ll = cl;
+
+        } else {
+            ctx->head = cl;
+        }
+
+        cl->buf = b;
+        cl->next = NULL;
+        ll = &cl->next;
+
+        ctx->size += b->last - b->pos;
+    }
+
+#endif
+
+    if (ngx_event_timer_lazy) {
+
+        /* the lazily re-armed timers of this worker and their early expires */
+
+        len = NGX_INT64_LEN                           /* pid */
+              + sizeof(" timers lazy ") - 1 + NGX_INT64_LEN
+              + sizeof(" early ") - 1 + NGX_INT64_LEN
+              + 2;                                    /* "\r\n" */
+
+        if (!(b = ngx_create_temp_buf(ctx->pool, len))) {
+            return NGX_ERROR;
+        }
+
+        b->last += ngx_snprintf((char *) b->last, len,
+                                PID_T_FMT " timers lazy %u early %u" CRLF,
+                                ngx_pid, ngx_event_timer_lazy_n,
+                                ngx_event_timer_early_n);
+
+        if (!(cl = ngx_alloc_chain_link(ctx->pool))) {
+            return NGX_ERROR;
+        }
+
+        if (ctx->head) {
+            *ll = cl;
+
+        } else {
+            ctx->head = cl;
+        }
+
+        cl->buf = b;
+        cl->next = NULL;
+        ll = &cl->next;
+
+        ctx->size += b->last - b->pos;
+    }
+
+#if (NGX_HTTP_GZIP)
+
+    if (ngx_http_gzip_cache_stat) {
+
+        /* the gzip cache zone is shared so the counters are of all workers */
+
+        len = NGX_INT64_LEN                           /* pid */
+              + sizeof(" gzip cache entries ") - 1 + NGX_INT64_LEN
+              + sizeof(" hits ") - 1 + NGX_INT64_LEN
+              + sizeof(" misses ") - 1 + NGX_INT64_LEN
+              + sizeof(" stores ") - 1 + NGX_INT64_LEN
+              + sizeof(" evictions ") - 1 + NGX_INT64_LEN
+              + 2;                                    /* "\r\n" */
+
+        if (!(b = ngx_create_temp_buf(ctx->pool, len))) {
+            return NGX_ERROR;
+        }
+
+        b->last += ngx_snprintf((char *) b->last, len,
+                                PID_T_FMT " gzip cache entries %u hits %u"
+                                " misses %u stores %u evictions %u" CRLF,
+                                ngx_pid,
+                                ngx_http_gzip_cache_stat->entries,
+                                ngx_http_gzip_cache_stat->hits,
+                                ngx_http_gzip_cache_stat->misses,
+                                ngx_http_gzip_cache_stat->stores,
+                                ngx_http_gzip_cache_stat->evictions);
+
+        if (!(cl = ngx_alloc_chain_link(ctx->pool))) {
+            return NGX_ERROR;
+        }
+
+        if (ctx->head) {
+            *ll = cl;
+
+        } else {
+            ctx->head = cl;
+        }
+
+        cl->buf = b;
+        cl->next = NULL;
+        ll = &cl->next;
+
+        ctx->size += b->last - b->pos;
+    }
+
+    if (ngx_http_gzip_level_stat.level) {
+
+        len = NGX_INT64_LEN                           /* pid */
+              + sizeof(" gzip level ") - 1 + NGX_INT64_LEN
+              + sizeof(" lowered ") - 1 + NGX_INT64_LEN
+              + sizeof(" lag ") - 1 + NGX_INT64_LEN
+              + sizeof(" cpu ") - 1 + NGX_INT64_LEN
+              + 2;                                    /* "\r\n" */
+
+        if (!(b = ngx_create_temp_buf(ctx->pool, len))) {
+            return NGX_ERROR;
+        }
+
+        b->last += ngx_snprintf((char *) b->last, len,
+                                PID_T_FMT " gzip level %u lowered %u"
+                                " lag %u cpu %u" CRLF,
+                                ngx_pid,
+                                ngx_http_gzip_level_stat.level,
+                                ngx_http_gzip_level_stat.lowered,
+                                ngx_http_gzip_level_stat.lag,
+                                ngx_http_gzip_level_stat.cpu);
+
+        if (!(cl = ngx_alloc_chain_link(ctx->pool))) {
+            return NGX_ERROR;
+        }
+
+        if (ctx->head) {
+            *ll = cl;
+
+        } else {
+            ctx->head = cl;
+        }
+
+        cl->buf = b;
+        cl->next = NULL;
+        ll = &cl->next;
+
+        ctx->size += b->last - b->pos;
+    }
+
+#endif
+
     ctx->last = b;
 
     return NGX_OK;
@@ -10,6 +10,9 @@
 #include <ngx_http_proxy_handler.h>
 
 
+#define NGX_HTTP_PROXY_HEADERS_HASH_MAX_SIZE  512
+
+
 static ngx_int_t ngx_http_proxy_handler(ngx_http_request_t *r);
 
 static u_char *ngx_http_proxy_log_proxy_state(ngx_http_request_t *r,
@@ -20,6 +23,8 @@ static u_char *ngx_http_proxy_log_reason(ngx_http_request_t *r, u_char *buf,
                                          uintptr_t data);
 
 static ngx_int_t ngx_http_proxy_pre_conf(ngx_conf_t *cf);
+static void *ngx_http_proxy_create_main_conf(ngx_conf_t *cf);
+static char *ngx_http_proxy_init_main_conf(ngx_conf_t *cf, void *conf);
 static void *ngx_http_proxy_create_loc_conf(ngx_conf_t *cf);
 static char *ngx_http_proxy_merge_loc_conf(ngx_conf_t *cf,
                                            void *parent, void *child);
@@ -226,8 +231,8 @@ static ngx_command_t  ngx_http_proxy_commands[] = {
 ngx_http_module_t  ngx_http_proxy_module_ctx = {
     ngx_http_proxy_pre_conf,               /* pre conf */
 
-    NULL,                                  /* create main configuration */
-    NULL,                                  /* init main configuration */
+    ngx_http_proxy_create_main_conf,       /* create main configuration */
+    ngx_http_proxy_init_main_conf,         /* init main configuration */
 
     NULL,                                  /* create server configuration */
     NULL,                                  /* merge server configuration */
@@ -855,6 +860,50 @@ static ngx_int_t ngx_http_proxy_pre_conf(ngx_conf_t *cf)
 }
 
 
+static void *ngx_http_proxy_create_main_conf(ngx_conf_t *cf)
+{
+    ngx_http_proxy_main_conf_t  *pmcf;
+
+    ngx_test_null(pmcf,
+                  ngx_pcalloc(cf->pool, sizeof(ngx_http_proxy_main_conf_t)),
+                  NGX_CONF_ERROR);
+
+    return pmcf;
+}
+
+
+static char *ngx_http_proxy_init_main_conf(ngx_conf_t *cf, void *conf)
+{
+    ngx_http_proxy_main_conf_t *pmcf = conf;
+
+    ngx_uint_t          n;
+    ngx_hash_key_t     *names;
+    ngx_http_header_t  *header;
+
+    for (n = 0; ngx_http_proxy_headers_in[n].name.len; n++) { /* void */ }
+
+    /* the upstream response headers hash */
+
+    ngx_test_null(names, ngx_palloc(cf->pool, n * sizeof(ngx_hash_key_t)),
+                  NGX_CONF_ERROR);
+
+    header = ngx_http_proxy_headers_in;
+
+    for (n = 0; header[n].name.len; n++) {
+        names[n].key = header[n].name;
+        names[n].value = &header[n];
+    }
+
+    if (ngx_hash_init(&pmcf->headers_in_hash, cf->pool, names, n,
+                      NGX_HTTP_PROXY_HEADERS_HASH_MAX_SIZE) == NGX_ERROR)
+    {
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
+
+
 static void *ngx_http_proxy_create_loc_conf(ngx_conf_t *cf)
 {
     ngx_http_proxy_loc_conf_t  *conf;
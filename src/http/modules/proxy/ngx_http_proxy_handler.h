@@ -39,6 +39,11 @@ typedef enum {
 } ngx_http_proxy_reason_e;
 
 
+typedef struct {
+    ngx_hash_t                       headers_in_hash;
+} ngx_http_proxy_main_conf_t;
+
+
 typedef struct {
     ngx_str_t                        url;
     ngx_str_t                        host;
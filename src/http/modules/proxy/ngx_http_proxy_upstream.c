@@ -993,18 +993,22 @@ static void ngx_http_proxy_process_upstream_status_line(ngx_event_t *rev)
  */
 static void ngx_http_proxy_process_upstream_headers(ngx_event_t *rev)
 {
-    int                    i, rc;
-    ssize_t                n;
-    ngx_table_elt_t       *h;
-    ngx_connection_t      *c;
-    ngx_http_request_t    *r;
-    ngx_http_proxy_ctx_t  *p;
+    int                          rc;
+    ssize_t                      n;
+    ngx_table_elt_t             *h;
+    ngx_connection_t            *c;
+    ngx_http_header_t           *header;
+    ngx_http_request_t          *r;
+    ngx_http_proxy_ctx_t        *p;
+    ngx_http_proxy_main_conf_t  *pmcf;
 
     c = rev->data;
     p = c->data;
     r = p->request;
     p->action = "reading upstream headers";
 
+    pmcf = ngx_http_get_module_main_conf(r, ngx_http_proxy_module);
+
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, rev->log, 0,
                    "http proxy process header line");
 
@@ -1061,18 +1065,12 @@ static void ngx_http_proxy_process_upstream_headers(ngx_event_t *rev)
             ngx_cpystrn(h->key.data, r->header_name_start, h->key.len + 1);
             ngx_cpystrn(h->value.data, r->header_start, h->value.len + 1);
 
-            for (i = 0; ngx_http_proxy_headers_in[i].name.len != 0; i++) {
-                if (ngx_http_proxy_headers_in[i].name.len != h->key.len) {
-                    continue;
-                }
-
-                if (ngx_strcasecmp(ngx_http_proxy_headers_in[i].name.data,
-                                                           h->key.data) == 0)
-                {
-                    *((ngx_table_elt_t **) ((char *) &p->upstream->headers_in
-                                   + ngx_http_proxy_headers_in[i].offset)) = h;
-                    break;
-                }
+            header = ngx_hash_find(&pmcf->headers_in_hash, r->header_hash,
+                                   h->key.data, h->key.len);
+
+            if (header) {
+                *((ngx_table_elt_t **) ((char *) &p->upstream->headers_in
+                                                      + header->offset)) = h;
             }
 
             ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
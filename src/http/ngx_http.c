@@ -16,6 +16,9 @@ static char *ngx_http_merge_locations(ngx_conf_t *cf,
                                       void **loc_conf,
                                       ngx_http_module_t *module,
                                       ngx_uint_t ctx_index);
+static ngx_int_t ngx_http_server_names(ngx_conf_t *cf,
+                                       ngx_http_core_main_conf_t *cmcf,
+                                       ngx_http_in_addr_t *in_addr);
 
 int         ngx_http_max_module;
 
@@ -474,6 +477,7 @@ static char *ngx_http_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         for (a = 0; a < in_port[p].addrs.nelts; a++) {
 
             virtual_names = 0;
+            in_addr[a].virtual_names = NULL;
 
             name = in_addr[a].names.elts;
             for (n = 0; n < in_addr[a].names.nelts; n++) {
@@ -490,6 +494,11 @@ static char *ngx_http_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 
             if (!virtual_names) {
                 in_addr[a].names.nelts = 0;
+                continue;
+            }
+
+            if (ngx_http_server_names(cf, cmcf, &in_addr[a]) == NGX_ERROR) {
+                return NGX_CONF_ERROR;
             }
         }
 
@@ -645,3 +654,93 @@ static char *ngx_http_merge_locations(ngx_conf_t *cf,
 
     return NGX_CONF_OK;
 }
+
+
+/*
+ * build the hash of the exact server names and the hashes
+ * of the "*.example.com" and "www.example.*" wildcard names
+ */
+
+static ngx_int_t ngx_http_server_names(ngx_conf_t *cf,
+                                       ngx_http_core_main_conf_t *cmcf,
+                                       ngx_http_in_addr_t *in_addr)
+{
+    ngx_uint_t                 n, nexact, nhead, ntail;
+    ngx_hash_key_t            *exact, *head, *tail;
+    ngx_http_server_name_t    *name;
+    ngx_http_virtual_names_t  *vn;
+
+    if (!(vn = ngx_pcalloc(cf->pool, sizeof(ngx_http_virtual_names_t)))) {
+        return NGX_ERROR;
+    }
+
+    n = in_addr->names.nelts;
+
+    if (!(exact = ngx_palloc(cf->pool, 3 * n * sizeof(ngx_hash_key_t)))) {
+        return NGX_ERROR;
+    }
+
+    head = exact + n;
+    tail = head + n;
+
+    nexact = 0;
+    nhead = 0;
+    ntail = 0;
+
+    name = in_addr->names.elts;
+    for (n = 0; n < in_addr->names.nelts; n++) {
+
+        if (name[n].name.len > 2
+            && name[n].name.data[0] == '*'
+            && name[n].name.data[1] == '.')
+        {
+            head[nhead].key.len = name[n].name.len - 1;
+            head[nhead].key.data = name[n].name.data + 1;
+            head[nhead].value = &name[n];
+            nhead++;
+
+            continue;
+        }
+
+        if (name[n].name.len > 2
+            && name[n].name.data[name[n].name.len - 1] == '*'
+            && name[n].name.data[name[n].name.len - 2] == '.')
+        {
+            tail[ntail].key.len = name[n].name.len - 1;
+            tail[ntail].key.data = name[n].name.data;
+            tail[ntail].value = &name[n];
+            ntail++;
+
+            continue;
+        }
+
+        exact[nexact].key = name[n].name;
+        exact[nexact].value = &name[n];
+        nexact++;
+    }
+
+    if (ngx_hash_init(&vn->names, cf->pool, exact, nexact,
+                      cmcf->server_names_hash_max_size) == NGX_ERROR)
+    {
+        return NGX_ERROR;
+    }
+
+    if (ngx_hash_init(&vn->wc_head, cf->pool, head, nhead,
+                      cmcf->server_names_hash_max_size) == NGX_ERROR)
+    {
+        return NGX_ERROR;
+    }
+
+    if (ngx_hash_init(&vn->wc_tail, cf->pool, tail, ntail,
+                      cmcf->server_names_hash_max_size) == NGX_ERROR)
+    {
+        return NGX_ERROR;
+    }
+
+    vn->nwc_head = nhead;
+    vn->nwc_tail = ntail;
+
+    in_addr->virtual_names = vn;
+
+    return NGX_OK;
+}
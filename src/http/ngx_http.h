@@ -104,6 +104,40 @@ extern ngx_http_output_header_filter_pt  ngx_http_top_header_filter;
 extern ngx_http_output_body_filter_pt    ngx_http_top_body_filter;
 
 
+#if (NGX_HTTP_GZIP)
+
+/* the counters of the gzip shared cache, NULL without "gzip_cache_zone" */
+
+typedef struct {
+    ngx_uint_t  entries;
+    ngx_uint_t  hits;
+    ngx_uint_t  misses;
+    ngx_uint_t  stores;
+    ngx_uint_t  evictions;
+} ngx_http_gzip_cache_stat_t;
+
+
+extern ngx_http_gzip_cache_stat_t  *ngx_http_gzip_cache_stat;
+
+
+/* the adaptive compression level of the worker, 0 without "gzip_adaptive" */
+
+typedef struct {
+    ngx_uint_t  level;
+    ngx_uint_t  lowered;
+    ngx_uint_t  lag;
+    ngx_uint_t  cpu;
+} ngx_http_gzip_level_stat_t;
+
+
+extern ngx_http_gzip_level_stat_t   ngx_http_gzip_level_stat;
+
+
+ngx_int_t ngx_http_gzip_ok(ngx_http_request_t *r);
+
+#endif
+
+
 /* STUB */
 ngx_int_t ngx_http_log_handler(ngx_http_request_t *r);
 /**/
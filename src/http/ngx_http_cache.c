@@ -41,7 +41,7 @@ ngx_http_cache_t *ngx_http_cache_get(ngx_http_cache_hash_t *hash,
     ngx_uint_t         i;
     ngx_http_cache_t  *c;
 
-    *crc = ngx_crc(key->data, key->len);
+    *crc = ngx_crc_fast(key->data, key->len);
 
     c = hash->elts + *crc % hash->hash * hash->nelts;
 
@@ -15,11 +15,13 @@
 #define NGX_HTTP_LOCATION_AUTO_REDIRECT   2
 #define NGX_HTTP_LOCATION_REGEX           3
 
+#define NGX_HTTP_HEADERS_HASH_MAX_SIZE    512
+
 
 static void ngx_http_phase_event_handler(ngx_event_t *rev);
 static void ngx_http_run_phases(ngx_http_request_t *r);
 static ngx_int_t ngx_http_find_location(ngx_http_request_t *r,
-                                        ngx_array_t *locations, size_t len);
+                                        ngx_http_location_tree_t *tree);
 
 static void *ngx_http_core_create_main_conf(ngx_conf_t *cf);
 static char *ngx_http_core_init_main_conf(ngx_conf_t *cf, void *conf);
@@ -32,6 +34,11 @@ static char *ngx_http_core_merge_loc_conf(ngx_conf_t *cf,
 
 static char *ngx_server_block(ngx_conf_t *cf, ngx_command_t *cmd, void *dummy);
 static int ngx_cmp_locations(const void *first, const void *second);
+static ngx_http_location_tree_t *ngx_http_create_location_tree(ngx_conf_t *cf,
+                                                        ngx_array_t *locations);
+static ngx_http_location_tree_node_t *ngx_http_create_location_tree_node(
+                 ngx_conf_t *cf, ngx_http_core_loc_conf_t **clcfp, ngx_uint_t n,
+                 size_t prefix);
 static char *ngx_location_block(ngx_conf_t *cf, ngx_command_t *cmd,
                                 void *dummy);
 static char *ngx_types_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
@@ -66,6 +73,13 @@ static ngx_command_t  ngx_http_core_commands[] = {
       0,
       NULL },
 
+    { ngx_string("server_names_hash_max_size"),
+      NGX_HTTP_MAIN_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_MAIN_CONF_OFFSET,
+      offsetof(ngx_http_core_main_conf_t, server_names_hash_max_size),
+      NULL },
+
     { ngx_string("connection_pool_size"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_size_slot,
@@ -418,9 +432,17 @@ static void ngx_http_run_phases(ngx_http_request_t *r)
 
     for (/* void */; r->phase < NGX_HTTP_LAST_PHASE; r->phase++) {
 
+        /*
+         * the pool statistics phases are shifted to leave 0 for "none",
+         * the allocations after the handlers return are not in any phase
+         */
+
+        ngx_pool_stat_phase(r->pool, r->phase + 1);
+
         if (r->phase == NGX_HTTP_CONTENT_PHASE && r->content_handler) {
             r->connection->write->event_handler = ngx_http_empty_handler;
             rc = r->content_handler(r);
+            ngx_pool_stat_phase(r->pool, 0);
             ngx_http_finalize_request(r, rc);
             return;
         }
@@ -430,6 +452,8 @@ static void ngx_http_run_phases(ngx_http_request_t *r)
              r->phase_handler >= 0;
              r->phase_handler--)
         {
+            ngx_pool_stat_phase(r->pool, r->phase + 1);
+
             rc = h[r->phase_handler](r);
 
             if (rc == NGX_DONE) {
@@ -442,6 +466,8 @@ static void ngx_http_run_phases(ngx_http_request_t *r)
                 return;
             }
 
+            ngx_pool_stat_phase(r->pool, 0);
+
             if (rc == NGX_DECLINED) {
                 continue;
             }
@@ -504,7 +530,7 @@ ngx_int_t ngx_http_find_location_config(ngx_http_request_t *r)
 
     cscf = ngx_http_get_module_srv_conf(r, ngx_http_core_module);
 
-    rc = ngx_http_find_location(r, &cscf->locations, 0);
+    rc = ngx_http_find_location(r, cscf->location_tree);
 
     if (rc == NGX_HTTP_INTERNAL_SERVER_ERROR) {
         return rc;
@@ -569,74 +595,113 @@ ngx_int_t ngx_http_find_location_config(ngx_http_request_t *r)
 
 
 static ngx_int_t ngx_http_find_location(ngx_http_request_t *r,
-                                        ngx_array_t *locations, size_t len)
+                                        ngx_http_location_tree_t *tree)
 {
-    ngx_int_t                  n, rc;
-    ngx_uint_t                 i, found;
-    ngx_http_core_loc_conf_t  *clcf, **clcfp;
+    u_char                          *p, ch;
+    size_t                           left;
+    ngx_int_t                        rc;
+    ngx_uint_t                       i, lo, hi;
+#if (HAVE_PCRE)
+    ngx_int_t                        n;
+#endif
+    ngx_http_core_loc_conf_t        *clcf, *found;
+    ngx_http_location_tree_node_t   *node, *child;
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, r->connection->log, 0, "find location");
 
-    found = 0;
+    found = NULL;
 
-    clcfp = locations->elts;
-    for (i = 0; i < locations->nelts; i++) {
+    node = tree->root;
+    p = r->uri.data;
+    left = r->uri.len;
 
-#if (HAVE_PCRE)
-        if (clcfp[i]->regex) {
-            break;
+    for ( ;; ) {
+
+        if (left == 0 && node->exact) {
+            r->loc_conf = node->exact->loc_conf;
+            return NGX_HTTP_LOCATION_EXACT;
         }
-#endif
 
-        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "find location: %s\"%s\"",
-                       clcfp[i]->exact_match ? "= " : "",
-                       clcfp[i]->name.data);
+        if (node->inclusive) {
+            found = node->inclusive;
 
-        if (clcfp[i]->auto_redirect
-            && r->uri.len == clcfp[i]->name.len - 1
-            && ngx_strncmp(r->uri.data, clcfp[i]->name.data,
-                                                  clcfp[i]->name.len - 1) == 0)
-        {
-            /* the locations are lexicographically sorted */
+        } else if (node->exact) {
+            /* the exact location matches the longer URI as inclusive one */
+            found = node->exact;
+        }
 
-            r->loc_conf = clcfp[i]->loc_conf;
+        /* the "/" child is tested for the auto redirect at the URI end */
 
-            return NGX_HTTP_LOCATION_AUTO_REDIRECT;
-        }
+        ch = left ? *p : '/';
 
-        if (r->uri.len < clcfp[i]->name.len) {
-            continue;
-        }
+        child = NULL;
+        lo = 0;
+        hi = node->nchildren;
 
-        n = ngx_strncmp(r->uri.data, clcfp[i]->name.data, clcfp[i]->name.len);
+        while (lo < hi) {
+            i = (lo + hi) / 2;
 
-        if (n < 0) {
-            /* the locations are lexicographically sorted */
+            if (node->children[i]->name[0] < ch) {
+                lo = i + 1;
+
+            } else if (node->children[i]->name[0] > ch) {
+                hi = i;
+
+            } else {
+                child = node->children[i];
+                break;
+            }
+        }
+
+        if (child == NULL) {
             break;
         }
 
-        if (n == 0) {
-            if (clcfp[i]->exact_match && r->uri.len == clcfp[i]->name.len) {
-                r->loc_conf = clcfp[i]->loc_conf;
-                return NGX_HTTP_LOCATION_EXACT;
-            }
+        if (left < child->len) {
 
-            if (len > clcfp[i]->name.len) {
-                /* the previous match is longer */
-                break;
+            if (left + 1 == child->len
+                && child->name[left] == '/'
+                && ngx_strncmp(p, child->name, left) == 0)
+            {
+                clcf = NULL;
+
+                if (child->exact && child->exact->auto_redirect) {
+                    clcf = child->exact;
+
+                } else if (child->inclusive && child->inclusive->auto_redirect)
+                {
+                    clcf = child->inclusive;
+                }
+
+                if (clcf) {
+                    r->loc_conf = clcf->loc_conf;
+                    return NGX_HTTP_LOCATION_AUTO_REDIRECT;
+                }
             }
 
-            r->loc_conf = clcfp[i]->loc_conf;
-            found = 1;
+            break;
+        }
+
+        if (ngx_strncmp(p, child->name, child->len) != 0) {
+            break;
         }
+
+        p += child->len;
+        left -= child->len;
+        node = child;
     }
 
     if (found) {
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "find location: %s\"%s\"",
+                       found->exact_match ? "= " : "", found->name.data);
+
+        r->loc_conf = found->loc_conf;
+
         clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
-        if (clcf->locations.nelts) {
-            rc = ngx_http_find_location(r, &clcf->locations, len);
+        if (clcf->location_tree) {
+            rc = ngx_http_find_location(r, clcf->location_tree);
 
             if (rc != NGX_OK) {
                 return rc;
@@ -648,17 +713,15 @@ static ngx_int_t ngx_http_find_location(ngx_http_request_t *r,
 
     /* regex matches */
 
-    for (/* void */; i < locations->nelts; i++) {
+    for (i = 0; i < tree->nregex; i++) {
 
-        if (!clcfp[i]->regex) {
-            continue;
-        }
+        clcf = tree->regex[i];
 
         ngx_log_debug1(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
                        "find location: ~ \"%s\"",
-                       clcfp[i]->name.data);
+                       clcf->name.data);
 
-        n = ngx_regex_exec(clcfp[i]->regex, &r->uri, NULL, 0);
+        n = ngx_regex_exec(clcf->regex, &r->uri, NULL, 0);
 
         if (n == NGX_DECLINED) {
             continue;
@@ -668,13 +731,13 @@ static ngx_int_t ngx_http_find_location(ngx_http_request_t *r,
             ngx_log_error(NGX_LOG_ALERT, r->connection->log, 0,
                           ngx_regex_exec_n
                           " failed: %d on \"%s\" using \"%s\"",
-                          n, r->uri.data, clcfp[i]->name.data);
+                          n, r->uri.data, clcf->name.data);
             return NGX_HTTP_INTERNAL_SERVER_ERROR;
         }
 
         /* match */
 
-        r->loc_conf = clcfp[i]->loc_conf;
+        r->loc_conf = clcf->loc_conf;
 
         return NGX_HTTP_LOCATION_REGEX;
     }
@@ -705,9 +768,6 @@ ngx_int_t ngx_http_set_content_type(ngx_http_request_t *r)
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
     if (r->exten.len) {
-#if 0
-        key = ngx_crc(r->exten.data, r->exten.key);
-#endif
         ngx_http_types_hash_key(key, r->exten);
 
         type = clcf->types[key].elts;
@@ -735,6 +795,11 @@ ngx_int_t ngx_http_set_content_type(ngx_http_request_t *r)
 
 ngx_int_t ngx_http_send_header(ngx_http_request_t *r)
 {
+    ngx_int_t    rc;
+#if (NGX_POOL_STAT)
+    ngx_uint_t   phase;
+#endif
+
     if (r->main) {
         return NGX_OK;
     }
@@ -744,20 +809,45 @@ ngx_int_t ngx_http_send_header(ngx_http_request_t *r)
         r->headers_out.status_line.len = 0;
     }
 
-    return (*ngx_http_top_header_filter)(r);
+#if (NGX_POOL_STAT)
+    phase = r->pool->stat_phase;
+    ngx_pool_stat_phase(r->pool, NGX_HTTP_LAST_PHASE + 1);
+#endif
+
+    rc = (*ngx_http_top_header_filter)(r);
+
+#if (NGX_POOL_STAT)
+    ngx_pool_stat_phase(r->pool, phase);
+#endif
+
+    return rc;
 }
 
 
 ngx_int_t ngx_http_output_filter(ngx_http_request_t *r, ngx_chain_t *in)
 {
-    ngx_int_t  rc;
+    ngx_int_t    rc;
+#if (NGX_POOL_STAT)
+    ngx_uint_t   phase;
+#endif
 
     if (r->connection->write->error) {
         return NGX_ERROR;
     }
 
+    /* the filters allocations are accounted as the "filter" phase */
+
+#if (NGX_POOL_STAT)
+    phase = r->pool->stat_phase;
+    ngx_pool_stat_phase(r->pool, NGX_HTTP_LAST_PHASE + 1);
+#endif
+
     rc = ngx_http_top_body_filter(r, in);
 
+#if (NGX_POOL_STAT)
+    ngx_pool_stat_phase(r->pool, phase);
+#endif
+
     if (rc == NGX_ERROR) {
 
         /* NGX_ERROR could be returned by any filter */
@@ -985,6 +1075,12 @@ static char *ngx_server_block(ngx_conf_t *cf, ngx_command_t *cmd, void *dummy)
     ngx_qsort(cscf->locations.elts, (size_t) cscf->locations.nelts,
               sizeof(ngx_http_core_loc_conf_t *), ngx_cmp_locations);
 
+    cscf->location_tree = ngx_http_create_location_tree(cf, &cscf->locations);
+
+    if (cscf->location_tree == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
     return rv;
 }
 
@@ -1022,6 +1118,167 @@ static int ngx_cmp_locations(const void *one, const void *two)
 }
 
 
+/*
+ * the prefix locations are sorted and compiled into the tree,
+ * the regex locations are kept in the configuration order,
+ * the trees of the nested locations are created recursively
+ */
+
+static ngx_http_location_tree_t *ngx_http_create_location_tree(ngx_conf_t *cf,
+                                                         ngx_array_t *locations)
+{
+    ngx_uint_t                  i, n;
+    ngx_http_location_tree_t   *tree;
+    ngx_http_core_loc_conf_t  **clcfp, **prefix;
+
+    if (!(tree = ngx_pcalloc(cf->pool, sizeof(ngx_http_location_tree_t)))) {
+        return NULL;
+    }
+
+    n = locations->nelts ? locations->nelts : 1;
+
+    if (!(prefix = ngx_palloc(cf->pool,
+                              n * sizeof(ngx_http_core_loc_conf_t *))))
+    {
+        return NULL;
+    }
+
+    if (!(tree->regex = ngx_palloc(cf->pool,
+                                   n * sizeof(ngx_http_core_loc_conf_t *))))
+    {
+        return NULL;
+    }
+
+    n = 0;
+
+    clcfp = locations->elts;
+    for (i = 0; i < locations->nelts; i++) {
+
+#if (HAVE_PCRE)
+        if (clcfp[i]->regex) {
+            tree->regex[tree->nregex++] = clcfp[i];
+            continue;
+        }
+#endif
+
+        prefix[n++] = clcfp[i];
+    }
+
+    ngx_qsort(prefix, (size_t) n, sizeof(ngx_http_core_loc_conf_t *),
+              ngx_cmp_locations);
+
+    if (!(tree->root = ngx_http_create_location_tree_node(cf, prefix, n, 0))) {
+        return NULL;
+    }
+
+    for (i = 0; i < locations->nelts; i++) {
+        if (clcfp[i]->locations.nelts == 0) {
+            continue;
+        }
+
+        clcfp[i]->location_tree = ngx_http_create_location_tree(cf,
+                                                     &clcfp[i]->locations);
+        if (clcfp[i]->location_tree == NULL) {
+            return NULL;
+        }
+    }
+
+    return tree;
+}
+
+
+/*
+ * the clcfp[] locations are sorted and their names have
+ * the same first "prefix" bytes
+ */
+
+static ngx_http_location_tree_node_t *ngx_http_create_location_tree_node(
+                 ngx_conf_t *cf, ngx_http_core_loc_conf_t **clcfp, ngx_uint_t n,
+                 size_t prefix)
+{
+    size_t                          len;
+    ngx_uint_t                      i, next, nchildren;
+    ngx_str_t                      *first, *last;
+    ngx_http_location_tree_node_t  *node, *child;
+
+    if (!(node = ngx_pcalloc(cf->pool, sizeof(ngx_http_location_tree_node_t))))
+    {
+        return NULL;
+    }
+
+    /* the locations that end at this node are the first ones */
+
+    for (i = 0; i < n && clcfp[i]->name.len == prefix; i++) {
+        if (clcfp[i]->exact_match) {
+            if (node->exact == NULL) {
+                node->exact = clcfp[i];
+            }
+
+        } else {
+            node->inclusive = clcfp[i];
+        }
+    }
+
+    clcfp += i;
+    n -= i;
+
+    nchildren = 0;
+
+    for (i = 0; i < n; i++) {
+        if (i == 0
+            || clcfp[i]->name.data[prefix] != clcfp[i - 1]->name.data[prefix])
+        {
+            nchildren++;
+        }
+    }
+
+    if (nchildren == 0) {
+        return node;
+    }
+
+    len = nchildren * sizeof(ngx_http_location_tree_node_t *);
+
+    if (!(node->children = ngx_palloc(cf->pool, len))) {
+        return NULL;
+    }
+
+    for (i = 0; i < n; i = next) {
+
+        for (next = i + 1; next < n; next++) {
+            if (clcfp[next]->name.data[prefix]
+                                            != clcfp[i]->name.data[prefix])
+            {
+                break;
+            }
+        }
+
+        /* the common prefix of the sorted names is the first and last one's */
+
+        first = &clcfp[i]->name;
+        last = &clcfp[next - 1]->name;
+
+        for (len = prefix + 1;
+             len < first->len && len < last->len
+             && first->data[len] == last->data[len];
+             len++)
+        { /* void */ }
+
+        child = ngx_http_create_location_tree_node(cf, &clcfp[i], next - i,
+                                                   len);
+        if (child == NULL) {
+            return NULL;
+        }
+
+        child->name = first->data + prefix;
+        child->len = len - prefix;
+
+        node->children[node->nchildren++] = child;
+    }
+
+    return node;
+}
+
+
 static char *ngx_location_block(ngx_conf_t *cf, ngx_command_t *cmd, void *dummy)
 {
     char                      *rv;
@@ -1241,17 +1498,41 @@ static void *ngx_http_core_create_main_conf(ngx_conf_t *cf)
                    5, sizeof(ngx_http_core_srv_conf_t *),
                    NGX_CONF_ERROR);
 
+    cmcf->server_names_hash_max_size = NGX_CONF_UNSET;
+
     return cmcf;
 }
 
 
 static char *ngx_http_core_init_main_conf(ngx_conf_t *cf, void *conf)
 {
-#if 0
     ngx_http_core_main_conf_t *cmcf = conf;
 
-    /* TODO: remove it if no directives */
-#endif
+    ngx_uint_t          n;
+    ngx_hash_key_t     *names;
+    ngx_http_header_t  *header;
+
+    ngx_conf_init_value(cmcf->server_names_hash_max_size, 512);
+
+    for (n = 0; ngx_http_headers_in[n].name.len; n++) { /* void */ }
+
+    /* the request headers hash */
+
+    ngx_test_null(names, ngx_palloc(cf->pool, n * sizeof(ngx_hash_key_t)),
+                  NGX_CONF_ERROR);
+
+    header = ngx_http_headers_in;
+
+    for (n = 0; header[n].name.len; n++) {
+        names[n].key = header[n].name;
+        names[n].value = &header[n];
+    }
+
+    if (ngx_hash_init(&cmcf->headers_in_hash, cf->pool, names, n,
+                      NGX_HTTP_HEADERS_HASH_MAX_SIZE) == NGX_ERROR)
+    {
+        return NGX_CONF_ERROR;
+    }
 
     return NGX_CONF_OK;
 }
@@ -58,9 +58,44 @@ typedef struct {
     ngx_array_t       index_handlers;
 
     size_t            max_server_name_len;
+    ngx_int_t         server_names_hash_max_size;
+
+    ngx_hash_t        headers_in_hash;
 } ngx_http_core_main_conf_t;
 
 
+typedef struct ngx_http_core_loc_conf_s  ngx_http_core_loc_conf_t;
+
+
+/*
+ * the prefix locations are compiled into the tree: every node has
+ * the part of the location name, and its children are sorted by
+ * the first byte of their parts
+ */
+
+typedef struct ngx_http_location_tree_node_s  ngx_http_location_tree_node_t;
+
+struct ngx_http_location_tree_node_s {
+    ngx_http_location_tree_node_t  **children;
+    ngx_uint_t                       nchildren;
+
+    ngx_http_core_loc_conf_t        *exact;
+    ngx_http_core_loc_conf_t        *inclusive;
+
+    size_t                           len;
+    u_char                          *name;
+};
+
+
+typedef struct {
+    ngx_http_location_tree_node_t   *root;
+
+    /* the regex locations in the configuration order */
+    ngx_http_core_loc_conf_t       **regex;
+    ngx_uint_t                       nregex;
+} ngx_http_location_tree_t;
+
+
 typedef struct {
     /*
      * array of ngx_http_core_loc_conf_t, used in the translation handler
@@ -68,6 +103,8 @@ typedef struct {
      */
     ngx_array_t           locations;
 
+    ngx_http_location_tree_t  *location_tree;
+
     /* "listen", array of ngx_http_listen_t */
     ngx_array_t           listen;
 
@@ -99,9 +136,26 @@ typedef struct {
 } ngx_http_in_port_t;
 
 
+/*
+ * the server names of the address:port: the exact names,
+ * the "*.example.com" names stored as ".example.com" and
+ * the "www.example.*" names stored as "www.example."
+ */
+
+typedef struct {
+    ngx_hash_t                 names;
+    ngx_hash_t                 wc_head;
+    ngx_hash_t                 wc_tail;
+
+    ngx_uint_t                 nwc_head;
+    ngx_uint_t                 nwc_tail;
+} ngx_http_virtual_names_t;
+
+
 typedef struct {
     in_addr_t                  addr;
     ngx_array_t                names;     /* array of ngx_http_server_name_t */
+    ngx_http_virtual_names_t  *virtual_names;
     ngx_http_core_srv_conf_t  *core_srv_conf;  /* default server conf
                                                   for this address:port */
 
@@ -118,13 +172,7 @@ typedef struct {
 #define NGX_HTTP_TYPES_HASH_PRIME  13
 
 #define ngx_http_types_hash_key(key, ext)                                   \
-        {                                                                   \
-            u_int n;                                                        \
-            for (key = 0, n = 0; n < ext.len; n++) {                        \
-                key += ext.data[n];                                         \
-            }                                                               \
-            key %= NGX_HTTP_TYPES_HASH_PRIME;                               \
-        }
+        key = ngx_crc_fast(ext.data, ext.len) % NGX_HTTP_TYPES_HASH_PRIME
 
 typedef struct {
     ngx_str_t  exten;
@@ -139,8 +187,6 @@ typedef struct {
 } ngx_http_err_page_t;
 
 
-typedef struct ngx_http_core_loc_conf_s  ngx_http_core_loc_conf_t;
-
 struct ngx_http_core_loc_conf_s {
     ngx_str_t     name;          /* location name */
 
@@ -155,6 +201,8 @@ struct ngx_http_core_loc_conf_s {
     /* array of inclusive ngx_http_core_loc_conf_t */
     ngx_array_t   locations;
 
+    ngx_http_location_tree_t  *location_tree;
+
     /* pointer to the modules' loc_conf */
     void        **loc_conf ;
 
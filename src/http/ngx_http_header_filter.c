@@ -316,10 +316,10 @@ static ngx_int_t ngx_http_header_filter(ngx_http_request_t *r)
 
     if (r->headers_out.content_length == NULL) {
         if (r->headers_out.content_length_n >= 0) {
-            b->last += ngx_snprintf((char *) b->last,
-                                sizeof("Content-Length: ") + NGX_OFF_T_LEN + 2,
-                                "Content-Length: " OFF_T_FMT CRLF,
-                                r->headers_out.content_length_n);
+            b->last = ngx_cpymem(b->last, "Content-Length: ",
+                                 sizeof("Content-Length: ") - 1);
+            b->last = ngx_sprint_int(b->last, r->headers_out.content_length_n);
+            *(b->last++) = CR; *(b->last++) = LF;
         }
     }
 
@@ -388,10 +388,10 @@ static ngx_int_t ngx_http_header_filter(ngx_http_request_t *r)
         if (clcf->keepalive_header
             && (r->headers_in.gecko || r->headers_in.konqueror))
         {
-            b->last += ngx_snprintf((char *) b->last,
-                            sizeof("Keep-Alive: timeout=") + TIME_T_LEN + 2,
-                            "Keep-Alive: timeout=" TIME_T_FMT CRLF,
-                            clcf->keepalive_header);
+            b->last = ngx_cpymem(b->last, "Keep-Alive: timeout=",
+                                 sizeof("Keep-Alive: timeout=") - 1);
+            b->last = ngx_sprint_int(b->last, clcf->keepalive_header);
+            *(b->last++) = CR; *(b->last++) = LF;
         }
 
     } else {
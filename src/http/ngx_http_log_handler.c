@@ -211,9 +211,7 @@ static u_char *ngx_http_log_addr(ngx_http_request_t *r, u_char *buf,
 static u_char *ngx_http_log_connection(ngx_http_request_t *r, u_char *buf,
                                      uintptr_t data)
 {
-    return buf + ngx_snprintf((char *) buf, NGX_INT_T_LEN + 1,
-                              "%" NGX_UINT_T_FMT,
-                              r->connection->number);
+    return ngx_sprint_uint(buf, r->connection->number);
 }
 
 
@@ -241,12 +239,18 @@ static u_char *ngx_http_log_time(ngx_http_request_t *r, u_char *buf,
 static u_char *ngx_http_log_msec(ngx_http_request_t *r, u_char *buf,
                                  uintptr_t data)
 {
-    struct timeval  tv;
+    ngx_time_t  tp;
 
-    ngx_gettimeofday(&tv);
+    ngx_time_get(&tp);
 
-    return buf + ngx_snprintf((char *) buf, TIME_T_LEN + 5, "%ld.%03ld",
-                              tv.tv_sec, tv.tv_usec / 1000);
+    buf = ngx_sprint_int(buf, tp.sec);
+
+    *buf++ = '.';
+    *buf++ = (u_char) ('0' + tp.msec / 100);
+    *buf++ = (u_char) ('0' + tp.msec / 10 % 10);
+    *buf++ = (u_char) ('0' + tp.msec % 10);
+
+    return buf;
 }
 
 
@@ -265,24 +269,22 @@ static u_char *ngx_http_log_request(ngx_http_request_t *r, u_char *buf,
 static u_char *ngx_http_log_status(ngx_http_request_t *r, u_char *buf,
                                    uintptr_t data)
 {
-    return buf + ngx_snprintf((char *) buf, 4, "%" NGX_UINT_T_FMT,
-                        r->err_status ? r->err_status : r->headers_out.status);
+    return ngx_sprint_uint(buf, r->err_status ? r->err_status
+                                              : r->headers_out.status);
 }
 
 
 static u_char *ngx_http_log_length(ngx_http_request_t *r, u_char *buf,
                                    uintptr_t data)
 {
-    return buf + ngx_snprintf((char *) buf, NGX_OFF_T_LEN + 1, OFF_T_FMT,
-                              r->connection->sent);
+    return ngx_sprint_int(buf, r->connection->sent);
 }
 
 
 static u_char *ngx_http_log_apache_length(ngx_http_request_t *r, u_char *buf,
                                           uintptr_t data)
 {
-    return buf + ngx_snprintf((char *) buf, NGX_OFF_T_LEN + 1, OFF_T_FMT,
-                              r->connection->sent - r->header_size);
+    return ngx_sprint_int(buf, r->connection->sent - r->header_size);
 }
 
 
@@ -451,9 +453,7 @@ static u_char *ngx_http_log_header_out(ngx_http_request_t *r, u_char *buf,
                 if (buf == NULL) {
                     return (u_char *) NGX_OFF_T_LEN;
                 }
-                return buf + ngx_snprintf((char *) buf,
-                                          NGX_OFF_T_LEN + 2, OFF_T_FMT,
-                                          r->headers_out.content_length_n);
+                return ngx_sprint_int(buf, r->headers_out.content_length_n);
             }
 
             if (data == offsetof(ngx_http_headers_out_t, last_modified)) {
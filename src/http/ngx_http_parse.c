@@ -9,6 +9,30 @@
 #include <ngx_http.h>
 
 
+/*
+ * the SSE2 is always available on amd64 and is enabled by -msse2 on i386,
+ * NGX_HTTP_PARSE_SCALAR allows to build the byte-at-a-time parser only
+ */
+
+#if (__SSE2__ && __GNUC__ && !(NGX_HTTP_PARSE_SCALAR))
+
+#include <emmintrin.h>
+
+#define NGX_HTTP_PARSE_SSE2  1
+
+
+static ngx_inline u_char *ngx_http_parse_skip(u_char *p, u_char *last,
+                                              u_char *chars, ngx_uint_t n);
+
+
+/* the characters that the URI and header value states handle specially */
+
+static u_char  ngx_http_uri_chars[] = { CR, LF, ' ', '.', '/', '%', '?' };
+static u_char  ngx_http_end_chars[] = { CR, LF, ' ' };
+
+#endif
+
+
 ngx_int_t ngx_http_parse_request_line(ngx_http_request_t *r, ngx_buf_t *b)
 {
     u_char  ch, *p, *m;
@@ -230,6 +254,10 @@ ngx_int_t ngx_http_parse_request_line(ngx_http_request_t *r, ngx_buf_t *b)
                 break;
             default:
                 state = sw_check_uri;
+#if (NGX_HTTP_PARSE_SSE2)
+                p = ngx_http_parse_skip(p, b->last, ngx_http_uri_chars,
+                                        sizeof(ngx_http_uri_chars));
+#endif
                 break;
             }
             break;
@@ -266,6 +294,12 @@ ngx_int_t ngx_http_parse_request_line(ngx_http_request_t *r, ngx_buf_t *b)
                 r->args_start = p;
                 state = sw_uri;
                 break;
+#if (NGX_HTTP_PARSE_SSE2)
+            default:
+                p = ngx_http_parse_skip(p, b->last, ngx_http_uri_chars,
+                                        sizeof(ngx_http_uri_chars));
+                break;
+#endif
             }
             break;
 
@@ -286,6 +320,12 @@ ngx_int_t ngx_http_parse_request_line(ngx_http_request_t *r, ngx_buf_t *b)
                 r->uri_end = p - 1;
                 state = sw_http_09;
                 break;
+#if (NGX_HTTP_PARSE_SSE2)
+            default:
+                p = ngx_http_parse_skip(p, b->last, ngx_http_end_chars,
+                                        sizeof(ngx_http_end_chars));
+                break;
+#endif
             }
             break;
 
@@ -446,7 +486,8 @@ ngx_int_t ngx_http_parse_request_line(ngx_http_request_t *r, ngx_buf_t *b)
 
 ngx_int_t ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b)
 {
-    u_char  c, ch, *p;
+    u_char      c, ch, *p;
+    ngx_uint_t  hash;
     enum {
         sw_start = 0,
         sw_name,
@@ -461,6 +502,7 @@ ngx_int_t ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b)
     } state;
 
     state = r->state;
+    hash = r->header_hash;
     p = b->pos;
 
     while (p < b->last && state < sw_done) {
@@ -483,16 +525,21 @@ ngx_int_t ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b)
                 state = sw_name;
                 r->header_name_start = p - 1;
 
+                /* the name hash is calculated in lowercase */
+
                 c = (u_char) (ch | 0x20);
                 if (c >= 'a' && c <= 'z') {
+                    hash = c;
                     break;
                 }
 
                 if (ch == '-' || ch == '_' || ch == '~' || ch == '.') {
+                    hash = ch;
                     break;
                 }
 
                 if (ch >= '0' && ch <= '9') {
+                    hash = ch;
                     break;
                 }
 
@@ -505,6 +552,7 @@ ngx_int_t ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b)
         case sw_name:
             c = (u_char) (ch | 0x20);
             if (c >= 'a' && c <= 'z') {
+                hash = ngx_hash(hash, c);
                 break;
             }
 
@@ -515,10 +563,12 @@ ngx_int_t ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b)
             }
 
             if (ch == '-' || ch == '_' || ch == '~' || ch == '.') {
+                hash = ngx_hash(hash, ch);
                 break;
             }
 
             if (ch >= '0' && ch <= '9') {
+                hash = ngx_hash(hash, ch);
                 break;
             }
 
@@ -550,6 +600,10 @@ ngx_int_t ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b)
             default:
                 r->header_start = p - 1;
                 state = sw_value;
+#if (NGX_HTTP_PARSE_SSE2)
+                p = ngx_http_parse_skip(p, b->last, ngx_http_end_chars,
+                                        sizeof(ngx_http_end_chars));
+#endif
                 break;
             }
             break;
@@ -569,6 +623,12 @@ ngx_int_t ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b)
                 r->header_end = p - 1;
                 state = sw_done;
                 break;
+#if (NGX_HTTP_PARSE_SSE2)
+            default:
+                p = ngx_http_parse_skip(p, b->last, ngx_http_end_chars,
+                                        sizeof(ngx_http_end_chars));
+                break;
+#endif
             }
             break;
 
@@ -585,6 +645,10 @@ ngx_int_t ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b)
                 break;
             default:
                 state = sw_value;
+#if (NGX_HTTP_PARSE_SSE2)
+                p = ngx_http_parse_skip(p, b->last, ngx_http_end_chars,
+                                        sizeof(ngx_http_end_chars));
+#endif
                 break;
             }
             break;
@@ -630,6 +694,7 @@ ngx_int_t ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b)
     }
 
     b->pos = p;
+    r->header_hash = hash;
 
     if (state == sw_done) {
         r->state = sw_start;
@@ -866,3 +931,42 @@ ngx_int_t ngx_http_parse_complex_uri(ngx_http_request_t *r)
 
     return NGX_OK;
 }
+
+
+#if (NGX_HTTP_PARSE_SSE2)
+
+/*
+ * the fast path of the parser: it skips 16 bytes at a time up to the block
+ * that has one of the characters, the found character itself and the tail
+ * of the buffer that is shorter than 16 bytes are left to the state machine
+ */
+
+static ngx_inline u_char *ngx_http_parse_skip(u_char *p, u_char *last,
+                                              u_char *chars, ngx_uint_t n)
+{
+    int         mask;
+    __m128i     v, m;
+    ngx_uint_t  i;
+
+    while (last - p >= 16) {
+        v = _mm_loadu_si128((__m128i *) p);
+
+        m = _mm_cmpeq_epi8(v, _mm_set1_epi8(chars[0]));
+
+        for (i = 1; i < n; i++) {
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(chars[i])));
+        }
+
+        mask = _mm_movemask_epi8(m);
+
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+
+        p += 16;
+    }
+
+    return p;
+}
+
+#endif
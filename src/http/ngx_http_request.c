@@ -20,6 +20,9 @@ static ssize_t ngx_http_read_request_header(ngx_http_request_t *r);
 static ngx_int_t ngx_http_alloc_large_header_buffer(ngx_http_request_t *r,
                                                     ngx_uint_t request_line);
 static ngx_int_t ngx_http_process_request_header(ngx_http_request_t *r);
+static ngx_http_server_name_t *ngx_http_find_virtual_server(
+                                  ngx_http_virtual_names_t *vn, u_char *host,
+                                  size_t len);
 
 static void ngx_http_set_write_handler(ngx_http_request_t *r);
 
@@ -312,7 +315,7 @@ static void ngx_http_init_request(ngx_event_t *rev)
         r->in_addr = in_addr[0].addr;
     }
 
-    r->virtual_names = &in_addr[i].names;
+    r->virtual_names = in_addr[i].virtual_names;
 
     /* the default server configuration for the address:port */
     cscf = in_addr[i].core_srv_conf;
@@ -718,11 +721,13 @@ static void ngx_http_process_request_line(ngx_event_t *rev)
 
 static void ngx_http_process_request_headers(ngx_event_t *rev)
 {
-    ssize_t              n;
-    ngx_int_t            rc, rv, i;
-    ngx_table_elt_t     *h, **cookie;
-    ngx_connection_t    *c;
-    ngx_http_request_t  *r;
+    ssize_t                     n;
+    ngx_int_t                   rc, rv;
+    ngx_table_elt_t            *h, **cookie;
+    ngx_connection_t           *c;
+    ngx_http_header_t          *header;
+    ngx_http_request_t         *r;
+    ngx_http_core_main_conf_t  *cmcf;
 
     c = rev->data;
     r = c->data;
@@ -730,6 +735,8 @@ static void ngx_http_process_request_headers(ngx_event_t *rev)
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, rev->log, 0,
                    "http process request header line");
 
+    cmcf = ngx_http_get_module_main_conf(r, ngx_http_core_module);
+
     if (rev->timedout) {
         ngx_http_client_error(r, 0, NGX_HTTP_REQUEST_TIME_OUT);
         return;
@@ -800,18 +807,12 @@ static void ngx_http_process_request_headers(ngx_event_t *rev)
 
             } else {
 
-                for (i = 0; ngx_http_headers_in[i].name.len != 0; i++) {
-                    if (ngx_http_headers_in[i].name.len != h->key.len) {
-                        continue;
-                    }
+                header = ngx_hash_find(&cmcf->headers_in_hash, r->header_hash,
+                                       h->key.data, h->key.len);
 
-                    if (ngx_strcasecmp(ngx_http_headers_in[i].name.data,
-                                       h->key.data) == 0)
-                    {
-                        *((ngx_table_elt_t **) ((char *) &r->headers_in
-                                         + ngx_http_headers_in[i].offset)) = h;
-                        break;
-                    }
+                if (header) {
+                    *((ngx_table_elt_t **) ((char *) &r->headers_in
+                                                      + header->offset)) = h;
                 }
             }
 
@@ -1078,11 +1079,60 @@ static ngx_int_t ngx_http_alloc_large_header_buffer(ngx_http_request_t *r,
 }
 
 
+static ngx_http_server_name_t *ngx_http_find_virtual_server(
+                                  ngx_http_virtual_names_t *vn, u_char *host,
+                                  size_t len)
+{
+    u_char                  *p, *last;
+    ngx_http_server_name_t  *name;
+
+    name = ngx_hash_find(&vn->names, ngx_hash_key_lc(host, len), host, len);
+
+    if (name) {
+        return name;
+    }
+
+    last = host + len;
+
+    /* the longest "*.example.com" match */
+
+    if (vn->nwc_head) {
+        for (p = host; (p = ngx_strlchr(p, last, '.')); p++) {
+            name = ngx_hash_find(&vn->wc_head, ngx_hash_key_lc(p, last - p),
+                                 p, last - p);
+
+            if (name) {
+                return name;
+            }
+        }
+    }
+
+    /* the longest "www.example.*" match */
+
+    if (vn->nwc_tail) {
+        for (p = last - 1; p > host; p--) {
+            if (*p != '.') {
+                continue;
+            }
+
+            name = ngx_hash_find(&vn->wc_tail,
+                                 ngx_hash_key_lc(host, p + 1 - host),
+                                 host, p + 1 - host);
+
+            if (name) {
+                return name;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
 static ngx_int_t ngx_http_process_request_header(ngx_http_request_t *r)
 {
     u_char                    *ua, *user_agent;
     size_t                     len;
-    ngx_uint_t                 i;
     ngx_http_server_name_t    *name;
     ngx_http_core_srv_conf_t  *cscf;
     ngx_http_core_loc_conf_t  *clcf;
@@ -1097,32 +1147,38 @@ static ngx_int_t ngx_http_process_request_header(ngx_http_request_t *r)
 
         /* find the name based server configuration */
 
-        name = r->virtual_names->elts;
-        for (i = 0; i < r->virtual_names->nelts; i++) {
-            if (r->headers_in.host_name_len != name[i].name.len) {
-                continue;
-            }
+        name = NULL;
 
-            if (ngx_strncasecmp(r->headers_in.host->value.data,
-                                name[i].name.data,
-                                r->headers_in.host_name_len) == 0)
+        if (r->virtual_names) {
+            name = ngx_http_find_virtual_server(r->virtual_names,
+                                                r->headers_in.host->value.data,
+                                                r->headers_in.host_name_len);
+        }
+
+        if (name) {
+            r->srv_conf = name->core_srv_conf->ctx->srv_conf;
+            r->loc_conf = name->core_srv_conf->ctx->loc_conf;
+
+            if (name->name.data[0] == '*'
+                || name->name.data[name->name.len - 1] == '*')
             {
-                r->srv_conf = name[i].core_srv_conf->ctx->srv_conf;
-                r->loc_conf = name[i].core_srv_conf->ctx->loc_conf;
-                r->server_name = &name[i].name;
+                /* the wildcard can not be used in the redirects */
 
-                clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
-                r->connection->log->file = clcf->err_log->file;
-                if (!(r->connection->log->log_level & NGX_LOG_DEBUG_CONNECTION))
-                {
-                    r->connection->log->log_level = clcf->err_log->log_level;
-                }
+                r->host_name.len = r->headers_in.host_name_len;
+                r->host_name.data = r->headers_in.host->value.data;
+                r->server_name = &r->host_name;
 
-                break;
+            } else {
+                r->server_name = &name->name;
             }
-        }
 
-        if (i == r->virtual_names->nelts) {
+            clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+            r->connection->log->file = clcf->err_log->file;
+            if (!(r->connection->log->log_level & NGX_LOG_DEBUG_CONNECTION)) {
+                r->connection->log->log_level = clcf->err_log->log_level;
+            }
+
+        } else {
             cscf = ngx_http_get_module_srv_conf(r, ngx_http_core_module);
 
             if (cscf->restrict_host_names != NGX_HTTP_RESTRICT_HOST_OFF) {
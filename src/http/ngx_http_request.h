@@ -195,6 +195,9 @@ typedef struct {
     off_t             content_length_n;
     time_t            date_time;
     time_t            last_modified_time;
+
+    /* the static file identity, it is 0 if the response is not a file */
+    ngx_file_uniq_t   file_uniq;
 } ngx_http_headers_out_t;
 
 
@@ -284,7 +287,8 @@ struct ngx_http_request_s {
     ngx_uint_t           port;
     ngx_str_t           *port_text;    /* ":80" */
     ngx_str_t           *server_name;
-    ngx_array_t         *virtual_names;
+    ngx_str_t            host_name;    /* the wildcard matched "Host" */
+    void                *virtual_names;  /* ngx_http_virtual_names_t */
 
     ngx_uint_t           phase;
     ngx_int_t            phase_handler;
@@ -344,6 +348,7 @@ struct ngx_http_request_s {
 
     /* used to parse HTTP headers */
     ngx_uint_t           state;
+    ngx_uint_t           header_hash;
     u_char              *uri_start;
     u_char              *uri_end;
     u_char              *uri_ext;
@@ -148,6 +148,13 @@ ngx_int_t ngx_http_write_filter(ngx_http_request_t *r, ngx_chain_t *in)
         return NGX_ERROR;
     }
 
+    /* free the links of the sent bufs */
+
+    for (cl = ctx->out; cl != chain; cl = ln) {
+        ln = cl->next;
+        ngx_free_chain(cl);
+    }
+
     ctx->out = chain;
 
     if (chain || c->buffered) {
@@ -0,0 +1,201 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ */
+
+
+/*
+ * The cache key hash benchmark: ngx_crc() and every ngx_crc_fast() version
+ * that the CPU supports are measured for the file names and the MIME type
+ * extensions, and the distribution over the small tables is reported as
+ * the chi-square of the bucket counts divided by the number of buckets,
+ * it is about 1 for the uniform hash.
+ *
+ *     make -f objs/Makefile crc_bench
+ *     objs/ngx_crc_bench [iterations]
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+#define NGX_BENCH_KEYS      8192
+#define NGX_BENCH_KEY_LEN   128
+
+/* NGX_HTTP_TYPES_HASH_PRIME */
+#define NGX_BENCH_TYPES     13
+
+
+typedef uint32_t (*ngx_bench_hash_pt)(u_char *data, size_t len);
+
+
+static char  *ngx_bench_dirs[] = {
+    "/", "/img/", "/static/js/", "/static/css/", "/images/products/",
+    "/usr/local/nginx/html/", "/var/www/example.com/htdocs/download/"
+};
+
+static char  *ngx_bench_extens[] = {
+    "html", "htm", "css", "js", "gif", "jpg", "jpeg", "png", "ico", "txt",
+    "xml", "rss", "swf", "pdf", "zip", "gz", "tar", "mp3", "avi", "mpg"
+};
+
+static ngx_uint_t  ngx_bench_sizes[] = { 7, 13, 31, 1021, 0 };
+
+
+#if (HAVE_VARIADIC_MACROS)
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, ...)
+
+#else
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, va_list args)
+
+#endif
+{
+    /* the benchmark does not log */
+}
+
+
+static uint32_t ngx_bench_crc(u_char *data, size_t len)
+{
+    return ngx_crc((char *) data, len);
+}
+
+
+static double ngx_bench_chi2(ngx_bench_hash_pt hash, ngx_str_t *keys,
+                             ngx_uint_t n, ngx_uint_t size)
+{
+    double      chi2, expected, d;
+    ngx_uint_t  i, *count;
+
+    count = calloc(size, sizeof(ngx_uint_t));
+    if (count == NULL) {
+        return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        count[hash(keys[i].data, keys[i].len) % size]++;
+    }
+
+    expected = (double) n / size;
+    chi2 = 0;
+
+    for (i = 0; i < size; i++) {
+        d = count[i] - expected;
+        chi2 += d * d / expected;
+    }
+
+    free(count);
+
+    return chi2 / size;
+}
+
+
+static void ngx_bench_run(char *name, ngx_bench_hash_pt hash,
+                          ngx_str_t *files, ngx_str_t *extens,
+                          ngx_uint_t nextens, ngx_uint_t total)
+{
+    size_t            bytes;
+    double            mbs;
+    uint32_t          sum;
+    ngx_uint_t        i, n;
+    struct timeval    start, end;
+    ngx_epoch_msec_t  usec;
+
+    sum = 0;
+    bytes = 0;
+
+    ngx_gettimeofday(&start);
+
+    for (n = 0; n < total; n++) {
+        i = n % NGX_BENCH_KEYS;
+        sum += hash(files[i].data, files[i].len);
+        bytes += files[i].len;
+    }
+
+    ngx_gettimeofday(&end);
+
+    usec = (end.tv_sec - start.tv_sec) * 1000000
+           + (end.tv_usec - start.tv_usec);
+
+    mbs = usec ? (double) bytes / usec : 0.0;
+
+    printf("%10s %8.1f %8.1f",
+           name, usec ? (double) usec * 1000 / total : 0.0, mbs);
+
+    for (i = 0; ngx_bench_sizes[i]; i++) {
+        printf(" %7.2f", ngx_bench_chi2(hash, files, NGX_BENCH_KEYS,
+                                        ngx_bench_sizes[i]));
+    }
+
+    printf(" %7.2f   %08x\n",
+           ngx_bench_chi2(hash, extens, nextens, NGX_BENCH_TYPES),
+           sum);
+}
+
+
+int main(int argc, char *const *argv)
+{
+    u_char        *p;
+    ngx_int_t      total;
+    ngx_uint_t     i, hw, nextens;
+    ngx_str_t     *files, extens[sizeof(ngx_bench_extens) / sizeof(char *)];
+    static char   *names[] = { "ngx_crc", "portable", "sse42" };
+
+    total = 10000000;
+
+    if (argc > 1) {
+        total = atoi(argv[1]);
+        if (total <= 0) {
+            fprintf(stderr, "invalid number of iterations \"%s\"\n", argv[1]);
+            return 1;
+        }
+    }
+
+    files = malloc(NGX_BENCH_KEYS * (sizeof(ngx_str_t) + NGX_BENCH_KEY_LEN));
+    if (files == NULL) {
+        return 1;
+    }
+
+    p = (u_char *) &files[NGX_BENCH_KEYS];
+
+    /* the file names that differ in a few digits as the real ones do */
+
+    for (i = 0; i < NGX_BENCH_KEYS; i++) {
+        files[i].data = p;
+        files[i].len = snprintf((char *) p, NGX_BENCH_KEY_LEN, "%sfile%u.%s",
+            ngx_bench_dirs[i % (sizeof(ngx_bench_dirs) / sizeof(char *))],
+            (unsigned) i,
+            ngx_bench_extens[i % (sizeof(ngx_bench_extens) / sizeof(char *))]);
+        p += NGX_BENCH_KEY_LEN;
+    }
+
+    nextens = sizeof(ngx_bench_extens) / sizeof(char *);
+
+    for (i = 0; i < nextens; i++) {
+        extens[i].data = (u_char *) ngx_bench_extens[i];
+        extens[i].len = ngx_strlen(ngx_bench_extens[i]);
+    }
+
+    printf("%10s %8s %8s %7s %7s %7s %7s %7s %10s\n",
+           "hash", "ns/key", "MB/s", "chi/7", "chi/13", "chi/31", "chi/1021",
+           "types", "checksum");
+
+    ngx_bench_run(names[0], ngx_bench_crc, files, extens, nextens, total);
+
+    for (hw = NGX_CRC_PORTABLE; hw <= NGX_CRC_SSE42; hw++) {
+        if (ngx_crc_init(hw) != hw) {
+            continue;
+        }
+
+        ngx_bench_run(names[hw + 1], ngx_crc_fast, files, extens, nextens,
+                      total);
+    }
+
+    free(files);
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ */
+
+
+/*
+ * The pool small allocations benchmark: the pool is grown to the given
+ * number of the almost full blocks and then the allocations that do not
+ * fit into these blocks are measured.
+ *
+ *     make -f objs/Makefile palloc_bench
+ *     objs/ngx_palloc_bench [allocations]
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+#define NGX_BENCH_POOL_SIZE  1024
+#define NGX_BENCH_ALLOC      32
+#define NGX_BENCH_BATCH      256
+
+
+static ngx_uint_t  ngx_bench_chains[] = { 1, 4, 16, 64, 256, 1024, 0 };
+
+
+#if (HAVE_VARIADIC_MACROS)
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, ...)
+
+#else
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, va_list args)
+
+#endif
+{
+    /* the benchmark does not log */
+}
+
+
+int main(int argc, char *const *argv)
+{
+    size_t             usable;
+    ngx_int_t          total;
+    ngx_uint_t         i, n, blocks, done;
+    ngx_log_t          log;
+    ngx_pool_t        *pool;
+    struct timeval     start, end;
+    ngx_epoch_msec_t   usec;
+
+    ngx_pagesize = getpagesize();
+
+    total = 1000000;
+
+    if (argc > 1) {
+        total = atoi(argv[1]);
+        if (total <= 0) {
+            fprintf(stderr, "invalid number of allocations \"%s\"\n", argv[1]);
+            return 1;
+        }
+    }
+
+    ngx_memzero(&log, sizeof(ngx_log_t));
+
+    usable = NGX_BENCH_POOL_SIZE - sizeof(ngx_pool_t);
+
+    printf("%10s %16s\n", "blocks", "allocs/sec");
+
+    for (i = 0; ngx_bench_chains[i]; i++) {
+
+        usec = 0;
+
+        for (done = 0; done < (ngx_uint_t) total; done += NGX_BENCH_BATCH) {
+
+            if (!(pool = ngx_create_pool(NGX_BENCH_POOL_SIZE, &log))) {
+                return 1;
+            }
+
+            /* leave less than NGX_BENCH_ALLOC bytes free in every block */
+
+            for (blocks = 0; blocks < ngx_bench_chains[i]; blocks++) {
+                if (ngx_palloc(pool, usable - NGX_BENCH_ALLOC / 2) == NULL) {
+                    return 1;
+                }
+            }
+
+            ngx_gettimeofday(&start);
+
+            for (n = 0; n < NGX_BENCH_BATCH; n++) {
+                if (ngx_palloc(pool, NGX_BENCH_ALLOC) == NULL) {
+                    return 1;
+                }
+            }
+
+            ngx_gettimeofday(&end);
+
+            usec += (end.tv_sec - start.tv_sec) * 1000000
+                    + (end.tv_usec - start.tv_usec);
+
+            ngx_destroy_pool(pool);
+        }
+
+        printf("%10u %16.0f\n", ngx_bench_chains[i],
+               usec ? (double) done * 1000000 / usec : 0.0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ */
+
+
+/*
+ * The radix tree lookups benchmark: the random prefixes are inserted
+ * into the 32-bit and 128-bit trees and the random keys are looked up
+ * in the binary tree and then in the compiled multibit tables.
+ *
+ *     make -f objs/Makefile radix_bench
+ *     objs/ngx_radix_bench [prefixes]
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+#define NGX_BENCH_LOOKUPS  (4 * 1024 * 1024)
+
+
+#if (HAVE_VARIADIC_MACROS)
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, ...)
+
+#else
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, va_list args)
+
+#endif
+{
+    /* the benchmark does not log */
+}
+
+
+static uint32_t ngx_bench_random()
+{
+    return ((uint32_t) random() << 16) ^ (uint32_t) random();
+}
+
+
+static double ngx_bench_rate(struct timeval *start, struct timeval *end)
+{
+    ngx_epoch_msec_t  usec;
+
+    usec = (end->tv_sec - start->tv_sec) * 1000000
+           + (end->tv_usec - start->tv_usec);
+
+    return usec ? (double) NGX_BENCH_LOOKUPS * 1000000 / usec : 0.0;
+}
+
+
+int main(int argc, char *const *argv)
+{
+    u_char             *keys128, key128[16], mask128[16];
+    uint32_t           *keys, key, mask;
+    uintptr_t           sum, found[2];
+    ngx_int_t           total;
+    ngx_uint_t          i, n, len, pass;
+    ngx_log_t           log;
+    ngx_pool_t         *pool;
+    struct timeval      start, end;
+    ngx_radix_tree_t   *tree;
+
+    ngx_pagesize = getpagesize();
+
+    total = 1000000;
+
+    if (argc > 1) {
+        total = atoi(argv[1]);
+        if (total <= 0) {
+            fprintf(stderr, "invalid number of prefixes \"%s\"\n", argv[1]);
+            return 1;
+        }
+    }
+
+    srandom(1);
+
+    ngx_memzero(&log, sizeof(ngx_log_t));
+
+    if (!(pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, &log))) {
+        return 1;
+    }
+
+    keys = ngx_alloc(NGX_BENCH_LOOKUPS * sizeof(uint32_t), &log);
+    keys128 = ngx_alloc(NGX_BENCH_LOOKUPS * 16, &log);
+
+    if (keys == NULL || keys128 == NULL) {
+        return 1;
+    }
+
+    for (i = 0; i < NGX_BENCH_LOOKUPS; i++) {
+        keys[i] = ngx_bench_random();
+
+        for (n = 0; n < 16; n += 4) {
+            key = ngx_bench_random();
+            ngx_memcpy(&keys128[i * 16 + n], &key, 4);
+        }
+
+        /* the half of the IPv6 keys share the prefix of the inserted ones */
+
+        if (i & 1) {
+            keys128[i * 16] = 0x20;
+            keys128[i * 16 + 1] = 0x01;
+        }
+    }
+
+    printf("%10s %10s %16s %16s\n", "bits", "prefixes", "binary/sec",
+           "compiled/sec");
+
+    /* 32-bit keys with the /8 - /32 prefixes */
+
+    if (!(tree = ngx_radix_tree_create(pool))) {
+        return 1;
+    }
+
+    for (i = 0; i < (ngx_uint_t) total; i++) {
+        len = 8 + ngx_bench_random() % 25;
+        mask = (uint32_t) (0 - (1 << (32 - len)));
+
+        if (ngx_radix32tree_insert(tree, ngx_bench_random() & mask, mask,
+                                   i + 1) == NGX_ERROR)
+        {
+            return 1;
+        }
+    }
+
+    for (pass = 0; pass < 2; pass++) {
+
+        if (pass == 1 && ngx_radix_tree_compile(tree) != NGX_OK) {
+            return 1;
+        }
+
+        sum = 0;
+
+        ngx_gettimeofday(&start);
+
+        for (i = 0; i < NGX_BENCH_LOOKUPS; i++) {
+            sum += ngx_radix32tree_find(tree, keys[i]);
+        }
+
+        ngx_gettimeofday(&end);
+
+        found[pass] = sum;
+
+        if (pass == 0) {
+            printf("%10d %10d %16.0f ", 32, (int) total,
+                   ngx_bench_rate(&start, &end));
+
+        } else {
+            printf("%16.0f\n", ngx_bench_rate(&start, &end));
+        }
+    }
+
+    if (found[0] != found[1]) {
+        fprintf(stderr, "the compiled 32-bit tree lookups differ\n");
+        return 1;
+    }
+
+    /* 128-bit keys with the /16 - /64 prefixes within 2001::/16 */
+
+    if (!(tree = ngx_radix_tree_create(pool))) {
+        return 1;
+    }
+
+    for (i = 0; i < (ngx_uint_t) total; i++) {
+        len = 16 + ngx_bench_random() % 49;
+
+        ngx_memzero(mask128, 16);
+
+        for (n = 0; n < len; n++) {
+            mask128[n / 8] |= (u_char) (0x80 >> (n % 8));
+        }
+
+        for (n = 0; n < 16; n++) {
+            key128[n] = (u_char) ngx_bench_random() & mask128[n];
+        }
+
+        key128[0] = 0x20;
+        key128[1] = 0x01;
+
+        if (ngx_radix128tree_insert(tree, key128, mask128, i + 1)
+                                                                  == NGX_ERROR)
+        {
+            return 1;
+        }
+    }
+
+    for (pass = 0; pass < 2; pass++) {
+
+        if (pass == 1 && ngx_radix_tree_compile(tree) != NGX_OK) {
+            return 1;
+        }
+
+        sum = 0;
+
+        ngx_gettimeofday(&start);
+
+        for (i = 0; i < NGX_BENCH_LOOKUPS; i++) {
+            sum += ngx_radix128tree_find(tree, &keys128[i * 16]);
+        }
+
+        ngx_gettimeofday(&end);
+
+        found[pass] = sum;
+
+        if (pass == 0) {
+            printf("%10d %10d %16.0f ", 128, (int) total,
+                   ngx_bench_rate(&start, &end));
+
+        } else {
+            printf("%16.0f\n", ngx_bench_rate(&start, &end));
+        }
+    }
+
+    if (found[0] != found[1]) {
+        fprintf(stderr, "the compiled 128-bit tree lookups differ\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ */
+
+
+/*
+ * The access log line formatting benchmark: the numbers of the line
+ * "addr - - [time] "request" status length msec connection" are formatted
+ * by ngx_snprintf() as the log handler did before and by the ngx_sprint_*()
+ * formatters, the lines must be the same.
+ *
+ *     make -f objs/Makefile sprint_bench
+ *     objs/ngx_sprint_bench [lines]
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+#define NGX_BENCH_LINE_LEN  256
+
+
+static char  ngx_bench_prefix[] =
+    "192.168.1.10 - - [28/Sep/1970:12:00:00 +0600] "
+    "\"GET /index.html HTTP/1.1\" ";
+
+
+#if (HAVE_VARIADIC_MACROS)
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, ...)
+
+#else
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, va_list args)
+
+#endif
+{
+    /* the benchmark does not log */
+}
+
+
+static u_char *ngx_bench_snprintf(u_char *p, ngx_uint_t status, off_t sent,
+                                  time_t sec, ngx_uint_t msec, ngx_uint_t n)
+{
+    p = ngx_cpymem(p, ngx_bench_prefix, sizeof(ngx_bench_prefix) - 1);
+
+    p += ngx_snprintf((char *) p, 4, "%" NGX_UINT_T_FMT, status);
+    *p++ = ' ';
+    p += ngx_snprintf((char *) p, NGX_OFF_T_LEN + 1, OFF_T_FMT, sent);
+    *p++ = ' ';
+    p += ngx_snprintf((char *) p, TIME_T_LEN + 5, "%ld.%03ld",
+                      (long) sec, (long) msec);
+    *p++ = ' ';
+    p += ngx_snprintf((char *) p, NGX_INT_T_LEN + 1, "%" NGX_UINT_T_FMT, n);
+
+    return p;
+}
+
+
+static u_char *ngx_bench_sprint(u_char *p, ngx_uint_t status, off_t sent,
+                                time_t sec, ngx_uint_t msec, ngx_uint_t n)
+{
+    p = ngx_cpymem(p, ngx_bench_prefix, sizeof(ngx_bench_prefix) - 1);
+
+    p = ngx_sprint_uint(p, status);
+    *p++ = ' ';
+    p = ngx_sprint_int(p, sent);
+    *p++ = ' ';
+    p = ngx_sprint_int(p, sec);
+    *p++ = '.';
+    *p++ = (u_char) ('0' + msec / 100);
+    *p++ = (u_char) ('0' + msec / 10 % 10);
+    *p++ = (u_char) ('0' + msec % 10);
+    *p++ = ' ';
+    p = ngx_sprint_uint(p, n);
+
+    return p;
+}
+
+
+int main(int argc, char *const *argv)
+{
+    u_char           *p, *last;
+    ngx_int_t         total;
+    ngx_uint_t        n, i, sum;
+    double            rate[2];
+    struct timeval    start, end;
+    ngx_epoch_msec_t  usec;
+    u_char            line[2][NGX_BENCH_LINE_LEN];
+
+    total = 10000000;
+
+    if (argc > 1) {
+        total = atoi(argv[1]);
+        if (total <= 0) {
+            fprintf(stderr, "invalid number of lines \"%s\"\n", argv[1]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < 2; i++) {
+        sum = 0;
+        last = line[i];
+
+        ngx_gettimeofday(&start);
+
+        for (n = 0; n < (ngx_uint_t) total; n++) {
+            p = line[i];
+
+            if (i == 0) {
+                last = ngx_bench_snprintf(p, 200 + n % 400, n * 7919,
+                                          1100000000 + n, n % 1000, n);
+            } else {
+                last = ngx_bench_sprint(p, 200 + n % 400, n * 7919,
+                                        1100000000 + n, n % 1000, n);
+            }
+
+            sum += last - p;
+        }
+
+        ngx_gettimeofday(&end);
+
+        usec = (end.tv_sec - start.tv_sec) * 1000000
+               + (end.tv_usec - start.tv_usec);
+
+        rate[i] = usec ? (double) usec * 1000 / total : 0.0;
+
+        *last = '\0';
+
+        printf("%-10s %8.1f ns/line, %u bytes, \"%s\"\n",
+               i ? "sprint" : "snprintf", rate[i], (unsigned) sum, line[i]);
+    }
+
+    if (ngx_strcmp(line[0], line[1]) != 0) {
+        fprintf(stderr, "the lines differ\n");
+        return 1;
+    }
+
+    return 0;
+}
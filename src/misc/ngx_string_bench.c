@@ -0,0 +1,155 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ */
+
+
+/*
+ * The string primitives benchmark: ngx_strlow(), ngx_memcasecmp(),
+ * ngx_strlchr() and ngx_strlascii() are measured for the short and long strings with every
+ * version that the CPU supports.  The checksums of the results must be
+ * the same for all versions.
+ *
+ *     make -f objs/Makefile string_bench
+ *     objs/ngx_string_bench [iterations]
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+
+
+#define NGX_BENCH_MAX_LEN  1024
+
+
+static size_t  ngx_bench_lens[] = { 4, 10, 15, 32, 100, 1024, 0 };
+
+static char   *ngx_bench_simd[] = { "scalar", "sse2", "avx2" };
+
+
+#if (HAVE_VARIADIC_MACROS)
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, ...)
+
+#else
+
+void ngx_log_error_core(ngx_uint_t level, ngx_log_t *log, ngx_err_t err,
+                        const char *fmt, va_list args)
+
+#endif
+{
+    /* the benchmark does not log */
+}
+
+
+static double ngx_bench_rate(struct timeval *start, ngx_uint_t total)
+{
+    struct timeval    end;
+    ngx_epoch_msec_t  usec;
+
+    ngx_gettimeofday(&end);
+
+    usec = (end.tv_sec - start->tv_sec) * 1000000
+           + (end.tv_usec - start->tv_usec);
+
+    return usec ? (double) total / usec : 0.0;
+}
+
+
+int main(int argc, char *const *argv)
+{
+    u_char          *p;
+    size_t           len;
+    double           low, cmp, chr, ascii;
+    ngx_int_t        total;
+    ngx_uint_t       i, n, simd, used, sum;
+    struct timeval   start;
+    static u_char    src[NGX_BENCH_MAX_LEN], dst[NGX_BENCH_MAX_LEN],
+                     lc[NGX_BENCH_MAX_LEN];
+
+    total = 10000000;
+
+    if (argc > 1) {
+        total = atoi(argv[1]);
+        if (total <= 0) {
+            fprintf(stderr, "invalid number of iterations \"%s\"\n", argv[1]);
+            return 1;
+        }
+    }
+
+    /*
+     * the mixed case header-like name without the '\n' and the non-ASCII
+     * byte but the last one
+     */
+
+    for (i = 0; i < NGX_BENCH_MAX_LEN; i++) {
+        src[i] = "Content-Type-X-Forwarded-For"[i % 28];
+        lc[i] = ngx_tolower(src[i]);
+    }
+
+    printf("%8s %6s %14s %14s %14s %14s %10s\n",
+           "version", "len", "strlow M/s", "casecmp M/s", "strlchr M/s",
+           "strlascii M/s", "checksum");
+
+    for (simd = NGX_STRING_SCALAR; simd <= NGX_STRING_AVX2; simd++) {
+
+        used = ngx_string_init(simd);
+
+        if (used != simd) {
+            continue;
+        }
+
+        for (i = 0; ngx_bench_lens[i]; i++) {
+
+            len = ngx_bench_lens[i];
+            src[len - 1] = '\n';
+            sum = 0;
+
+            ngx_gettimeofday(&start);
+
+            for (n = 0; n < (ngx_uint_t) total; n++) {
+                ngx_strlow(dst, src, len);
+                sum += dst[n % len];
+            }
+
+            low = ngx_bench_rate(&start, total);
+
+            ngx_gettimeofday(&start);
+
+            for (n = 0; n < (ngx_uint_t) total; n++) {
+                sum += ngx_memcasecmp(src, lc, len - 1) == 0;
+            }
+
+            cmp = ngx_bench_rate(&start, total);
+
+            ngx_gettimeofday(&start);
+
+            for (n = 0; n < (ngx_uint_t) total; n++) {
+                p = ngx_strlchr(src, src + len, '\n');
+                sum += p - src;
+            }
+
+            chr = ngx_bench_rate(&start, total);
+
+            src[len - 1] = 0xc0;
+
+            ngx_gettimeofday(&start);
+
+            for (n = 0; n < (ngx_uint_t) total; n++) {
+                p = ngx_strlascii(src, src + len);
+                sum += p - src;
+            }
+
+            ascii = ngx_bench_rate(&start, total);
+
+            src[len - 1] = "Content-Type-X-Forwarded-For"[(len - 1) % 28];
+
+            printf("%8s %6u %14.1f %14.1f %14.1f %14.1f   %08x\n",
+                   ngx_bench_simd[simd], (unsigned) len, low, cmp, chr, ascii,
+                   (unsigned) sum);
+        }
+    }
+
+    return 0;
+}
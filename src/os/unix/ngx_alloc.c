@@ -8,7 +8,8 @@
 #include <ngx_core.h>
 
 
-int ngx_pagesize;
+int         ngx_pagesize;
+ngx_uint_t  ngx_pagesize_shift;
 
 
 // ngx_alloc 完成内存的申请，并将结果记录日志
@@ -36,7 +36,8 @@ void *ngx_memalign(size_t alignment, size_t size, ngx_log_t *log);
 #endif
 
 
-extern int ngx_pagesize;
+extern int         ngx_pagesize;
+extern ngx_uint_t  ngx_pagesize_shift;
 
 
 #endif /* _NGX_ALLOC_H_INCLUDED_ */
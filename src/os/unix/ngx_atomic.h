@@ -146,6 +146,15 @@ static ngx_inline uint32_t ngx_atomic_cmp_set(ngx_atomic_t *lock,
 #endif
 
 
+/*
+ * i386, amd64 and sparc in TSO mode do not reorder the stores with
+ * the stores and the loads with the loads, so the compiler barrier
+ * is enough to order the seqlock counter and the data
+ */
+
+#define ngx_memory_barrier()  __asm__ volatile ("" ::: "memory")
+
+
 void ngx_spinlock(ngx_atomic_t *lock, ngx_uint_t spin);
 
 #define ngx_trylock(lock)  (*(lock) == 0 && ngx_atomic_cmp_set(lock, 0, 1))
@@ -171,6 +171,14 @@ int ngx_create_thread(ngx_tid_t *tid, void* (*func)(void *arg), void *arg,
 }
 
 
+/*
+ * the worker threads and the threads of the modules, e.g. the gzip threads,
+ * share the limit, the stacks and the arrays, so the function may be called
+ * several times: the arrays are allocated for NGX_MAX_THREADS threads
+ * once and the next calls only raise the limit; the caller that runs
+ * the events in the threads sets ngx_threaded itself
+ */
+
 ngx_int_t ngx_init_threads(int n, size_t size, ngx_cycle_t *cycle)
 {
     char              *red_zone, *zone;
@@ -178,6 +186,16 @@ ngx_int_t ngx_init_threads(int n, size_t size, ngx_cycle_t *cycle)
     ngx_int_t          i;
     struct sigaction   sa;
 
+    if (max_threads) {
+        max_threads += n;
+
+        if (max_threads > NGX_MAX_THREADS + 1) {
+            max_threads = NGX_MAX_THREADS + 1;
+        }
+
+        return NGX_OK;
+    }
+
     max_threads = n + 1;
 
     for (i = 0; i < n; i++) {
@@ -224,13 +242,14 @@ ngx_int_t ngx_init_threads(int n, size_t size, ngx_cycle_t *cycle)
 
     /* create the threads errno's array */
 
-    if (!(errnos = ngx_calloc(n * sizeof(int), cycle->log))) {
+    if (!(errnos = ngx_calloc(NGX_MAX_THREADS * sizeof(int), cycle->log))) {
         return NGX_ERROR;
     }
 
     /* create the threads tids array */
 
-    if (!(tids = ngx_calloc((n + 1) * sizeof(ngx_tid_t), cycle->log))) {
+    tids = ngx_calloc((NGX_MAX_THREADS + 1) * sizeof(ngx_tid_t), cycle->log);
+    if (tids == NULL) {
         return NGX_ERROR;
     }
 
@@ -238,8 +257,8 @@ ngx_int_t ngx_init_threads(int n, size_t size, ngx_cycle_t *cycle)
 
     /* create the threads tls's array */
 
-    ngx_tls = ngx_calloc(NGX_THREAD_KEYS_MAX * (n + 1) * sizeof(void *),
-                         cycle->log);
+    ngx_tls = ngx_calloc(NGX_THREAD_KEYS_MAX * (NGX_MAX_THREADS + 1)
+                         * sizeof(void *), cycle->log);
     if (ngx_tls == NULL) {
         return NGX_ERROR;
     }
@@ -253,8 +272,6 @@ ngx_int_t ngx_init_threads(int n, size_t size, ngx_cycle_t *cycle)
     /* allow the spinlock in libc malloc() */
     __isthreaded = 1;
 
-    ngx_threaded = 1;
-
     return NGX_OK;
 }
 
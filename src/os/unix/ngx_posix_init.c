@@ -102,11 +102,14 @@ ngx_signal_t  signals[] = {
  */ 
 ngx_int_t ngx_posix_init(ngx_log_t *log)
 {
+    ngx_uint_t         n;
     ngx_signal_t      *sig;
     struct sigaction   sa;
 
     ngx_pagesize = getpagesize();
 
+    for (n = ngx_pagesize; n >>= 1; ngx_pagesize_shift++) { /* void */ }
+
     if (ngx_ncpu == 0) {
         ngx_ncpu = 1;
     }
@@ -153,7 +156,6 @@ void ngx_posix_status(ngx_log_t *log)
 void ngx_signal_handler(int signo)
 {
     char            *action;
-    struct timeval   tv;
     ngx_int_t        ignore;
     ngx_err_t        err;
     ngx_signal_t    *sig;
@@ -168,8 +170,7 @@ void ngx_signal_handler(int signo)
         }
     }
 
-    ngx_gettimeofday(&tv);
-    ngx_time_update(tv.tv_sec);
+    ngx_time_update();
 
     action = "";
 
@@ -114,7 +114,6 @@ void ngx_master_process_cycle(ngx_cycle_t *cycle, ngx_master_ctx_t *ctx)
     ngx_uint_t         live;
     live = 1;
 
-    struct timeval     tv;
     struct itimerval   itv;
     for ( ;; ) {
         /* delay 变量用来表示等待子进程退出的时间。
@@ -164,8 +163,7 @@ void ngx_master_process_cycle(ngx_cycle_t *cycle, ngx_master_ctx_t *ctx)
         // 信号发生会调用 ngx_signal_handler 函数，修改各种值
         sigsuspend(&set);
 
-        ngx_gettimeofday(&tv);
-        ngx_time_update(tv.tv_sec);
+        ngx_time_update();
 
         ngx_log_debug0(NGX_LOG_DEBUG_EVENT, cycle->log, 0, "wake up");
 
@@ -266,7 +264,8 @@ void ngx_master_process_cycle(ngx_cycle_t *cycle, ngx_master_ctx_t *ctx)
 
 void ngx_single_process_cycle(ngx_cycle_t *cycle, ngx_master_ctx_t *ctx)
 {
-    ngx_uint_t  i;
+    ngx_uint_t        i;
+    ngx_core_conf_t  *ccf;
 
 #if 0
     ngx_setproctitle("single worker process");
@@ -274,6 +273,10 @@ void ngx_single_process_cycle(ngx_cycle_t *cycle, ngx_master_ctx_t *ctx)
 
     ngx_init_temp_number();
 
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    ngx_pool_cache_init(ccf->pool_cache);
+
     for (i = 0; ngx_modules[i]; i++) {
         if (ngx_modules[i]->init_process) {
             if (ngx_modules[i]->init_process(cycle) == NGX_ERROR) {
@@ -289,6 +292,10 @@ void ngx_single_process_cycle(ngx_cycle_t *cycle, ngx_master_ctx_t *ctx)
         ngx_process_events(cycle);
         // ngx_event_actions.process_events(cycle);
 
+        if (ngx_event_lag_enabled) {
+            ngx_event_update_lag();
+        }
+
         if (ngx_terminate || ngx_quit) {
             ngx_master_exit(cycle, ctx);
         }
@@ -646,6 +653,20 @@ static void ngx_worker_process_cycle(ngx_cycle_t *cycle, void *data)
 
     ngx_init_temp_number();
 
+#if (NGX_THREADS)
+
+    /* the cached pool blocks are not protected from the worker threads */
+
+    if (ngx_threads_n == 0) {
+        ngx_pool_cache_init(ccf->pool_cache);
+    }
+
+#else
+
+    ngx_pool_cache_init(ccf->pool_cache);
+
+#endif
+
     /*
      * disable deleting previous events for the listening sockets because
      * in the worker processes there are no events at all at this point
@@ -722,6 +743,8 @@ static void ngx_worker_process_cycle(ngx_cycle_t *cycle, void *data)
             exit(2);
         }
 
+        ngx_threaded = 1;
+
         err = ngx_thread_key_create(&ngx_core_tls_key);
         if (err != 0) {
             ngx_log_error(NGX_LOG_ALERT, cycle->log, err,
@@ -750,8 +773,7 @@ static void ngx_worker_process_cycle(ngx_cycle_t *cycle, void *data)
 #endif
 
     for ( ;; ) {
-        if (ngx_exiting && ngx_event_timer_rbtree == &ngx_event_timer_sentinel)
-        {
+        if (ngx_exiting && ngx_event_find_timer() == NGX_TIMER_INFINITE) {
             ngx_log_error(NGX_LOG_INFO, cycle->log, 0, "exiting");
 
 
@@ -776,6 +798,10 @@ static void ngx_worker_process_cycle(ngx_cycle_t *cycle, void *data)
         ngx_process_events(cycle);
         // ngx_event_actions.process_events(cycle);
 
+        if (ngx_event_lag_enabled) {
+            ngx_event_update_lag();
+        }
+
         if (ngx_terminate) {
             ngx_log_error(NGX_LOG_INFO, cycle->log, 0, "exiting");
 
@@ -10,6 +10,7 @@
 
 static ngx_uint_t   nthreads;
 static ngx_uint_t   max_threads;
+static ngx_uint_t   thr_attr_inited;
 
 
 static pthread_attr_t  thr_attr;
@@ -42,11 +43,22 @@ int ngx_create_thread(ngx_tid_t *tid, void* (*func)(void *arg), void *arg,
 }
 
 
+/*
+ * the worker threads and the threads of the modules, e.g. the gzip threads,
+ * share the limit and the attributes, so the function may be called
+ * several times; the caller that runs the events in the threads sets
+ * ngx_threaded itself
+ */
+
 ngx_int_t ngx_init_threads(int n, size_t size, ngx_cycle_t *cycle)
 {   
     int  err;
 
-    max_threads = n;
+    max_threads += n;
+
+    if (thr_attr_inited) {
+        return NGX_OK;
+    }
 
     err = pthread_attr_init(&thr_attr);
 
@@ -64,7 +76,7 @@ ngx_int_t ngx_init_threads(int n, size_t size, ngx_cycle_t *cycle)
         return NGX_ERROR;
     }
 
-    ngx_threaded = 1;
+    thr_attr_inited = 1;
 
     return NGX_OK;
 }